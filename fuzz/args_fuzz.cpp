@@ -0,0 +1,40 @@
+/**
+ * @file args_fuzz.cpp
+ * @brief libFuzzer target for the command line parser.
+ *
+ * The input is split at NUL bytes into arguments, so the fuzzer finds
+ * option names and values alike. Parsing must never crash, hang or read
+ * past an argument, whatever it is given.
+ */
+
+#include "excserial/args.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t *data,
+                                      std::size_t size) {
+  // Copies, so ASan catches reads past the end of any argument
+  std::vector<std::string> storage;
+  std::string current;
+  for (std::size_t i = 0; i < size; ++i) {
+    if (data[i] == 0) {
+      storage.push_back(current);
+      current.clear();
+    } else {
+      current.push_back(static_cast<char>(data[i]));
+    }
+  }
+  storage.push_back(current);
+
+  std::vector<const char *> args;
+  for (const auto &arg : storage)
+    args.push_back(arg.c_str());
+
+  excserial::Options options;
+  excserial::ArgError error;
+  excserial::parse_args(args, options, error);
+  return 0;
+}
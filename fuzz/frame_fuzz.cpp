@@ -0,0 +1,61 @@
+/**
+ * @file frame_fuzz.cpp
+ * @brief libFuzzer target for the parsers of received bytes.
+ *
+ * Feeds the input to the delta frame reference decoder byte by byte, as
+ * firmware would from a noisy line, and as a response to the Modbus
+ * parser. Whatever arrives, neither may crash or write past its buffers,
+ * and a frame the decoder accepts must encode back to valid frames.
+ */
+
+#include "excserial/frame.h"
+#include "excserial/modbus.h"
+#include "excserial_delta.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <span>
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t *data,
+                                      std::size_t size) {
+  excserial_delta_decoder decoder;
+  excserial_delta_init(&decoder);
+  std::int32_t values[EXCSERIAL_DELTA_CHANNELS];
+  for (std::size_t i = 0; i < size; ++i) {
+    if (!excserial_delta_feed(&decoder, data[i], values))
+      continue;
+    // Decoded values re-encode to a key frame the decoder reads back
+    excserial::FrameEncoder encoder{excserial::FrameFormat::delta};
+    excserial::FrameBuffer frame;
+    const auto frame_size = encoder.encode(
+        {values[0], values[1], values[2], values[3]}, frame);
+    excserial_delta_decoder check;
+    excserial_delta_init(&check);
+    std::int32_t decoded[EXCSERIAL_DELTA_CHANNELS];
+    int frames = 0;
+    for (std::size_t j = 0; j < frame_size; ++j) {
+      frames += excserial_delta_feed(
+          &check, static_cast<std::uint8_t>(frame[j]), decoded);
+    }
+    if (frames != 1)
+      std::abort();
+    for (int channel = 0; channel < EXCSERIAL_DELTA_CHANNELS; ++channel) {
+      if (decoded[channel] != values[channel])
+        std::abort();
+    }
+  }
+
+  // The first byte picks the register count the response is checked for
+  if (size == 0)
+    return 0;
+  std::array<std::uint16_t, excserial::modbus_max_registers> registers{};
+  const auto count = data[0] % (excserial::modbus_max_registers + 1);
+  std::uint8_t exception_code = 0;
+  excserial::parse_read_response(
+      {data + 1, size - 1}, data[0] % 248,
+      excserial::ModbusFunction::read_holding_registers,
+      std::span{registers}.first(count), exception_code);
+  return 0;
+}
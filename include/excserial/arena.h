@@ -0,0 +1,75 @@
+/**
+ * @file arena.h
+ * @brief Pre-sized memory for everything a port needs while running.
+ *
+ * Buffers are carved out of one block allocated at start, on the port's NUMA
+ * node, so nothing touches the global heap once frames are flowing. Heap
+ * allocations per thread can be counted to check that guarantee.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+
+namespace excserial {
+
+/**
+ * Monotonic arena over one block. Nothing is freed until reset(), which
+ * suits buffers sized once at start. Running out falls back to the heap and
+ * is counted in overflow(), so a too small arena shows up instead of
+ * failing.
+ */
+class Arena {
+public:
+  Arena();
+  ~Arena();
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  /// Releases everything and allocates a new block of capacity bytes on
+  /// numa_node, or where the OS chooses for -1. Not while in use.
+  void reset(std::size_t capacity, int numa_node = -1);
+
+  std::pmr::memory_resource *resource() {
+    return &*monotonic_;
+  }
+  std::size_t capacity() const {
+    return capacity_;
+  }
+  /// Bytes that didn't fit and came from the heap.
+  std::size_t overflow() const {
+    return upstream_.bytes;
+  }
+
+private:
+  /// Heap fallback that remembers how much it handed out.
+  struct CountingResource final : std::pmr::memory_resource {
+    std::size_t bytes = 0;
+
+    void *do_allocate(std::size_t size, std::size_t alignment) override;
+    void do_deallocate(void *memory, std::size_t size,
+                       std::size_t alignment) override;
+    bool do_is_equal(const memory_resource &other) const noexcept override {
+      return this == &other;
+    }
+  };
+
+  void *block_ = nullptr;
+  std::size_t capacity_ = 0;
+  CountingResource upstream_;
+  std::optional<std::pmr::monotonic_buffer_resource> monotonic_;
+};
+
+/// Counts one global heap allocation on the calling thread. Called by the
+/// operator new of excserial_heap_counter, counts stay 0 in programs that
+/// don't link it.
+void count_heap_allocation();
+
+/// Heap allocations counted on the calling thread so far.
+std::uint64_t thread_heap_allocations();
+
+} // namespace excserial
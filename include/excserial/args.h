@@ -0,0 +1,153 @@
+/**
+ * @file args.h
+ * @brief Command line parsing for the excserial executable.
+ *
+ * Parsing never allocates and never throws, malformed input only ends up as
+ * an ArgError.
+ */
+
+#pragma once
+
+#include "excserial/burst.h"
+#include "excserial/bus.h"
+#include "excserial/clock.h"
+#include "excserial/link_budget.h"
+#include "excserial/modbus.h"
+#include "excserial/placement.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+
+namespace excserial {
+
+/// Upper limit of the frame rate.
+inline constexpr double max_rate_hz = 1000.0;
+
+/// Most frames in one --burst, the burst is encoded into one buffer.
+inline constexpr std::uint32_t max_burst_frames = 100'000;
+
+/// Most --device options, the devices of one bus.
+inline constexpr std::size_t max_bus_devices = 32;
+
+/// A --device option, an addressed device on an RS-485 bus.
+struct DeviceSpec {
+  std::uint8_t address = 0;
+  double rate_hz = 0.0; ///< 0 for the base rate
+  std::int32_t priority = 0;
+};
+
+/// Most --poll options.
+inline constexpr std::size_t max_polls = 32;
+
+/// A --poll option, a Modbus slave read at its own rate.
+struct PollSpec {
+  std::uint8_t slave = 0;
+  double rate_hz = 0.0; ///< 0 for the base rate
+};
+
+/// A --stream option, channels updated at their own rate.
+struct RateSpec {
+  std::uint32_t channels = 0; ///< Bit mask, bit 0 is channel 1
+  double rate_hz = 0.0;
+};
+
+/// Most writer threads of --writers.
+inline constexpr std::uint32_t max_writer_threads = 64;
+
+/// Parsed command line, the views point into argv.
+struct Options {
+  /// "excserial selftest [PORT] [--jitter-budget us]", port is optional
+  bool selftest = false;
+  std::chrono::nanoseconds jitter_budget = std::chrono::microseconds(100);
+
+  std::string_view port;
+  std::uint32_t baud_rate = 115200;
+  FrameFormat format = FrameFormat::text;
+  std::int32_t value = 0;
+  double rate_hz = 0.0;
+  std::string_view shm_name;
+  std::int32_t shm_range = 0; ///< --range, largest shm value, 0 for any
+  double virtual_seconds = 0.0; ///< 0 for a real-time run
+  std::optional<std::uint64_t> expected_hash;
+  double min_rate = 0.0;
+  std::string_view trace_path; ///< Chrome trace output, empty disables
+  PacingMode pacing = PacingMode::spin;
+  SpinMode spin = SpinMode::yield;
+  double lateness_percentile = 0.99; ///< Given in percent on the command line
+  Placement placement; ///< --cpu, --numa-node N or --numa-node port
+  double dashboard_hz = 0.0; ///< Full screen view refreshes, 0 for a line
+  bool align_to_wall_clock = false; ///< --align utc
+  /// Bursts at wire speed instead of one frame per period, rate unused.
+  std::optional<BurstPattern> burst;
+  /// Transmit queue level of an unpaced soak run, 0 for a paced run.
+  std::chrono::nanoseconds soak_fill{0};
+
+  /// Devices sharing the port as an RS-485 bus, --bus-policy, --rts and
+  /// --turnaround in bus.
+  std::array<DeviceSpec, max_bus_devices> devices{};
+  std::size_t device_count = 0;
+  BusSettings bus;
+
+  /// Modbus slaves polled for the registers set by --registers, with --rts
+  /// in bus.direction.
+  std::array<PollSpec, max_polls> polls{};
+  std::size_t poll_count = 0;
+  std::uint16_t poll_address = 0;
+  std::uint16_t poll_registers = 4;
+  std::chrono::nanoseconds response_timeout = std::chrono::milliseconds(50);
+
+  /// Multi-rate streams, channels not listed run at rate_hz. port may then
+  /// list several ports, "COM3,COM4", each sent the same streams.
+  std::array<RateSpec, 4> streams{};
+  std::size_t stream_count = 0;
+  /// Threads of a WriterPool writing to the ports, 0 sizes it by port
+  /// count. Unset, the scheduler thread writes itself.
+  std::optional<std::uint32_t> writer_threads;
+};
+
+/// Why parsing failed, message is static text and arg points into argv.
+struct ArgError {
+  std::string_view message;
+  std::string_view arg;
+};
+
+/**
+ * Parses "PORT VALUE RATE [options]" or "selftest [PORT] [options]", args
+ * excludes the program name.
+ * @return false with error filled in on invalid input.
+ */
+bool parse_args(std::span<const char *const> args, Options &options,
+                ArgError &error);
+
+/**
+ * Worst case load of the line settings describe for the frames options
+ * send, as the executable checks it before the first frame. Empty for runs
+ * without a paced line: selftest, virtual, burst, soak and poll runs.
+ */
+std::optional<LinkBudget> plan_link(const Options &options,
+                                    const PortSettings &settings);
+
+/// Whole-string conversions, false on trailing junk or out of range.
+bool parse_number(std::string_view text, std::int32_t &value);
+bool parse_number(std::string_view text, std::uint32_t &value);
+bool parse_number(std::string_view text, double &value);
+bool parse_hex(std::string_view text, std::uint64_t &value);
+/// "12@1000": channels 1 and 2 at 1000 Hz.
+bool parse_rate_spec(std::string_view text, RateSpec &spec);
+/// "3", "3@100" or "3@100:2": device 3 at the base rate or 100 Hz, with
+/// priority 2.
+bool parse_device_spec(std::string_view text, DeviceSpec &spec);
+/// "3" or "3@100": Modbus slave 3 at the base rate or 100 Hz.
+bool parse_poll_spec(std::string_view text, PollSpec &spec);
+/// "8" or "100+8": 8 registers from address 0 or 100.
+bool parse_register_range(std::string_view text, std::uint16_t &address,
+                          std::uint16_t &count);
+/// "50x10@100": 10 bursts of 50 frames, 100 ms apart. 0 bursts repeats
+/// until stopped.
+bool parse_burst_spec(std::string_view text, BurstPattern &pattern);
+
+} // namespace excserial
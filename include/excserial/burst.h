@@ -0,0 +1,100 @@
+/**
+ * @file burst.h
+ * @brief Bursts of back-to-back frames for stress testing receivers.
+ *
+ * Instead of one frame per period, each burst is pre-encoded into one buffer
+ * and handed to the port in a single write, so the frames leave at wire
+ * speed. After the burst has drained from the transmit queue the line idles
+ * for the gap before the next one.
+ */
+
+#pragma once
+
+#include "excserial/clock.h"
+#include "excserial/frame.h"
+#include "excserial/port.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace excserial {
+
+struct BurstPattern {
+  std::uint32_t frames = 10; ///< Frames per burst
+  /// Idle time between a burst leaving the port and the next one.
+  std::chrono::nanoseconds gap = std::chrono::milliseconds(100);
+  std::uint32_t repetitions = 1; ///< Bursts to send, 0 until stopped
+};
+
+/// Counters of a burst run.
+struct BurstStats {
+  std::uint64_t bursts = 0;
+  std::uint64_t frames = 0;
+  std::uint64_t bytes = 0;
+  /// From the start of each write until the transmit queue drained, summed.
+  std::chrono::nanoseconds wire_time{0};
+
+  /// Bytes per second while bursting, 0 before the first burst.
+  double throughput() const;
+};
+
+/// Appends frames encoded frames of values to out, flipping the sign between
+/// frames when alternate. Delta bursts start with a key frame, so the buffer
+/// can be sent again as is.
+void encode_burst(const Values &values, std::uint32_t frames, bool alternate,
+                  std::vector<char> &out,
+                  FrameFormat format = FrameFormat::text);
+
+/**
+ * Sends a BurstPattern from a dedicated thread. Operations return false on
+ * failure and leave a description in error().
+ */
+class BurstSender {
+public:
+  BurstSender() = default;
+  ~BurstSender();
+
+  BurstSender(const BurstSender &) = delete;
+  BurstSender &operator=(const BurstSender &) = delete;
+
+  /// Starts sending to port, which must outlive the run. The gap is waited
+  /// out with pacing.
+  bool start(Port &port, const BurstPattern &pattern, const Values &values,
+             bool alternate, PacingMode pacing = PacingMode::sleep,
+             FrameFormat format = FrameFormat::text);
+
+  void stop();
+
+  /// False once all repetitions are sent, after stop() or a write error.
+  bool running() const {
+    return running_.load(std::memory_order_acquire);
+  }
+
+  BurstStats stats() const;
+
+  /// Not safe to call while running().
+  const std::string &error() const {
+    return error_;
+  }
+
+private:
+  void run();
+
+  Port *port_ = nullptr;
+  BurstPattern pattern_;
+  std::vector<char> burst_; ///< Pre-encoded, written as is every time
+  SteadyClock clock_;
+  std::thread thread_;
+  std::atomic_bool running_{false};
+  std::atomic_bool stop_requested_{false};
+  std::string error_;
+
+  std::atomic<std::uint64_t> bursts_{0};
+  std::atomic<std::int64_t> wire_ns_{0};
+};
+
+} // namespace excserial
@@ -0,0 +1,240 @@
+/**
+ * @file bus.h
+ * @brief Several addressed devices sharing one half-duplex RS-485 line.
+ *
+ * Every frame is prefixed with the address of the device it is for, so each
+ * device on a multi-drop bus picks out its own. Devices get frames at their
+ * own period. Frames that come due together go out back to back in one
+ * transmission, so the line changes direction once per transmission rather
+ * than once per frame. After each transmission the line idles for the
+ * turnaround time the transceivers need, which is accounted like the bytes.
+ */
+
+#pragma once
+
+#include "excserial/clock.h"
+#include "excserial/frame.h"
+#include "excserial/pacer.h"
+#include "excserial/port.h"
+#include "excserial/scheduler.h"
+#include "excserial/value_slot.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace excserial {
+
+/// Starts the address header of binary and delta frames.
+inline constexpr unsigned char bus_address_mark = 0xAB;
+
+/// Longest address header, "@255" before a text frame.
+inline constexpr std::size_t max_address_size = 4;
+
+/**
+ * Encodes the header addressing a frame of frame_size bytes: "@<address>"
+ * before text frames, bus_address_mark, the address and frame_size before
+ * binary and delta frames, so devices can skip frames of any length that
+ * are not theirs.
+ * @return Number of bytes written to out.
+ */
+std::size_t encode_address(FrameFormat format, std::uint8_t address,
+                           std::size_t frame_size,
+                           std::span<char, max_address_size> out);
+
+/// Which of the frames due together go first.
+enum class BusPolicy {
+  round_robin, ///< In turn, starting after the device served last
+  priority,    ///< Highest priority first, then earliest deadline
+};
+
+inline constexpr BusPolicy bus_policies[] = {BusPolicy::round_robin,
+                                             BusPolicy::priority};
+
+std::string_view to_string(BusPolicy policy);
+std::optional<BusPolicy> parse_bus_policy(std::string_view name);
+
+/// How the transceiver is switched between sending and receiving.
+enum class DirectionControl {
+  none,   ///< Transceiver switches by itself, or a full duplex line
+  driver, ///< Driver raises RTS while sending, PortSettings::rts_toggle
+  /// RTS raised before each transmission and dropped once its last byte
+  /// has left the UART
+  manual,
+};
+
+inline constexpr DirectionControl direction_controls[] = {
+    DirectionControl::none, DirectionControl::driver,
+    DirectionControl::manual};
+
+std::string_view to_string(DirectionControl control);
+std::optional<DirectionControl> parse_direction_control(
+    std::string_view name);
+
+/**
+ * Writes data with the transceiver switched as control says. The bytes
+ * can't be out before the line rate allows, with manual control RTS is
+ * dropped only once the driver queue is empty and a character more has
+ * passed for the UART shift register, dropping it early cuts off the last
+ * byte.
+ * @param released Set to when the line was free again.
+ * @return false on a port error, left in port.error().
+ */
+bool send_half_duplex(Port &port, Clock &clock, DirectionControl control,
+                      std::span<const char> data, double line_limit,
+                      Clock::time_point &released);
+
+struct BusDevice {
+  std::uint8_t address = 1;
+  Period period{std::chrono::milliseconds(10)};
+  Values values{};
+  bool alternate = false; ///< Flip the sign after every frame
+  /// Higher goes first under BusPolicy::priority.
+  std::int32_t priority = 0;
+};
+
+struct BusSettings {
+  BusPolicy policy = BusPolicy::round_robin;
+  DirectionControl direction = DirectionControl::manual;
+  /// Idle line after each transmission, for the driver to release the bus
+  /// and the devices to turn their transceivers around.
+  std::chrono::nanoseconds turnaround = std::chrono::microseconds(100);
+  /// Most bytes in one transmission, 0 for no limit. Bounds how long one
+  /// transmission holds back devices that come due meanwhile, at least
+  /// max_address_size + max_frame_size.
+  std::size_t max_transmission = 0;
+};
+
+/// Where the time on the bus went since start.
+struct BusStats {
+  std::uint64_t frames = 0;
+  std::uint64_t transmissions = 0;
+  std::uint64_t bytes = 0;
+  /// Frames held back to a later transmission by max_transmission.
+  std::uint64_t deferred = 0;
+  std::chrono::nanoseconds wire{0}; ///< Bytes at the line rate
+  /// Direction changes and idle turnaround, the bus carried no data.
+  std::chrono::nanoseconds turnaround{0};
+  std::chrono::nanoseconds elapsed{0};
+
+  /// Share of the time the line carried bytes.
+  double utilization() const;
+};
+
+/**
+ * Sends frames to the devices of one bus from a dedicated thread. Devices
+ * are added before start(). Operations return false on failure and leave a
+ * description in error().
+ */
+class BusScheduler {
+public:
+  BusScheduler() = default;
+  ~BusScheduler();
+
+  BusScheduler(const BusScheduler &) = delete;
+  BusScheduler &operator=(const BusScheduler &) = delete;
+
+  /// Paces with clock instead of the steady clock. Not owned.
+  void use_clock(Clock &clock) {
+    clock_ = &clock;
+  }
+
+  /// Wait strategy of the steady clock. Not while running.
+  void set_pacing(PacingMode mode, SpinMode spin) {
+    steady_clock_.set_mode(mode);
+    steady_clock_.set_spin_mode(spin);
+  }
+
+  /// Wire format of every device's frames. Not while running.
+  void set_format(FrameFormat format) {
+    format_ = format;
+  }
+
+  /// Not while running.
+  void set_settings(const BusSettings &settings) {
+    settings_ = settings;
+  }
+
+  /// @return Index for update_values() and lateness().
+  std::size_t add_device(const BusDevice &device);
+
+  /// Replaces the values of a device. Thread safe.
+  void update_values(std::size_t device, const Values &values);
+
+  /**
+   * Starts sending to port, which must outlive the run. Stops by itself
+   * after frame_limit frames if not 0. DirectionControl::driver needs the
+   * port opened with PortSettings::rts_toggle.
+   * @param line_limit Bytes per second the line carries, see line_limit().
+   */
+  bool start(Port &port, double line_limit, std::uint64_t frame_limit = 0);
+  void stop();
+
+  bool running() const {
+    return running_.load(std::memory_order_acquire);
+  }
+
+  BusStats stats() const;
+  /// One device's timing, lateness of its first byte on the wire.
+  StreamLateness lateness(std::size_t device) const;
+
+  /// Not safe to call while running().
+  const std::string &error() const {
+    return error_;
+  }
+
+private:
+  struct DeviceState {
+    BusDevice config;
+    ValueSlot values;
+    FrameEncoder encoder;
+    PeriodAccumulator offset;
+    std::int32_t sign = 1;
+    std::atomic<std::uint64_t> ticks{0};
+    std::atomic<std::uint64_t> missed{0};
+    std::atomic<std::int64_t> lateness_sum_ns{0};
+    std::atomic<std::int64_t> lateness_max_ns{0};
+  };
+
+  void run(std::uint64_t frame_limit);
+  /// Puts the due devices in the order of the policy.
+  void order_due();
+  /// Sends transmission_, returns once the line may carry the next one.
+  bool transmit(Clock::time_point now);
+
+  SteadyClock steady_clock_;
+  Clock *clock_ = &steady_clock_;
+  FrameFormat format_ = FrameFormat::text;
+  BusSettings settings_;
+  Port *port_ = nullptr;
+  double line_limit_ = 0.0;
+  std::deque<DeviceState> devices_; ///< Deque, atomics can't move
+  std::mutex update_mutex_;
+  std::size_t next_turn_ = 0; ///< First device of the next round robin turn
+  std::vector<std::size_t> due_;
+  std::vector<char> transmission_;
+  Clock::time_point line_free_;
+  std::thread thread_;
+  std::atomic_bool running_{false};
+  std::atomic_bool stop_requested_{false};
+  std::string error_;
+
+  std::atomic<std::uint64_t> frames_{0};
+  std::atomic<std::uint64_t> transmissions_{0};
+  std::atomic<std::uint64_t> bytes_{0};
+  std::atomic<std::uint64_t> deferred_{0};
+  std::atomic<std::int64_t> wire_ns_{0};
+  std::atomic<std::int64_t> turnaround_ns_{0};
+  std::atomic<std::int64_t> elapsed_ns_{0};
+};
+
+} // namespace excserial
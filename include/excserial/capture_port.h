@@ -0,0 +1,61 @@
+/**
+ * @file capture_port.h
+ * @brief Simulated port that fingerprints the byte stream.
+ */
+
+#pragma once
+
+#include "excserial/port.h"
+
+#include <cstdint>
+#include <string>
+
+namespace excserial {
+
+/**
+ * Accepts every write and keeps a 64-bit FNV-1a hash of all bytes, so two
+ * runs can be compared without storing their output. The bytes themselves
+ * are only kept when requested.
+ */
+class CapturePort final : public Port {
+public:
+  explicit CapturePort(bool keep_data = false) : keep_data_(keep_data) {
+  }
+
+  bool write(std::span<const char> data) override;
+
+  const std::string &name() const override {
+    return name_;
+  }
+  const std::string &error() const override {
+    return error_;
+  }
+
+  std::uint64_t hash() const {
+    return hash_;
+  }
+  std::uint64_t bytes() const {
+    return bytes_;
+  }
+  std::uint64_t writes() const {
+    return writes_;
+  }
+  /// Everything written, empty unless constructed with keep_data.
+  const std::string &data() const {
+    return data_;
+  }
+
+private:
+  static constexpr std::uint64_t fnv_offset = 14695981039346656037ull;
+  static constexpr std::uint64_t fnv_prime = 1099511628211ull;
+
+  bool keep_data_;
+  std::uint64_t hash_ = fnv_offset;
+  std::uint64_t bytes_ = 0;
+  std::uint64_t writes_ = 0;
+  std::string data_;
+  std::string name_ = "capture";
+  std::string error_;
+};
+
+} // namespace excserial
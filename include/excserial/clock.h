@@ -0,0 +1,131 @@
+/**
+ * @file clock.h
+ * @brief Time source for the pacer, real or virtual.
+ */
+
+#pragma once
+
+#include "excserial/spin.h"
+#include "excserial/spin_tuner.h"
+
+#include <chrono>
+#include <optional>
+#include <string_view>
+
+namespace excserial {
+
+/// Time source and sleep used by the pacer.
+class Clock {
+public:
+  using time_point = std::chrono::steady_clock::time_point;
+
+  virtual ~Clock() = default;
+
+  virtual time_point now() = 0;
+
+  /// Returns once now() has reached deadline.
+  virtual void sleep_until(time_point deadline) = 0;
+};
+
+/// How SteadyClock waits for a deadline.
+enum class PacingMode {
+  spin,   ///< Yield in a loop, most precise and a full core
+  sleep,  ///< Plain thread sleep, cheap and as coarse as the OS timer
+  hybrid, ///< Sleep until shortly before the deadline, then spin
+  timer,  ///< High resolution waitable timer
+  /// Hybrid with a spin window learned from the measured sleep overshoot
+  adaptive,
+};
+
+inline constexpr PacingMode pacing_modes[] = {
+    PacingMode::spin, PacingMode::sleep, PacingMode::hybrid,
+    PacingMode::timer, PacingMode::adaptive};
+
+std::string_view to_string(PacingMode mode);
+std::optional<PacingMode> parse_pacing_mode(std::string_view name);
+
+/// Wall time from std::chrono::steady_clock.
+class SteadyClock final : public Clock {
+public:
+  explicit SteadyClock(PacingMode mode = PacingMode::spin);
+  ~SteadyClock() override;
+
+  SteadyClock(const SteadyClock &) = delete;
+  SteadyClock &operator=(const SteadyClock &) = delete;
+
+  time_point now() override {
+    return std::chrono::steady_clock::now();
+  }
+
+  void sleep_until(time_point deadline) override;
+
+  void set_mode(PacingMode mode);
+  PacingMode mode() const {
+    return mode_;
+  }
+
+  /// How early the hybrid mode stops sleeping and starts spinning.
+  void set_spin_window(std::chrono::nanoseconds window) {
+    spin_window_ = window;
+  }
+  /// Spin window of the current mode, the learned one for adaptive.
+  std::chrono::nanoseconds spin_window() const {
+    return mode_ == PacingMode::adaptive ? tuner_.window() : spin_window_;
+  }
+
+  /// What the spin, hybrid and adaptive modes do while busy waiting.
+  void set_spin_mode(SpinMode mode) {
+    spin_mode_ = mode;
+  }
+  SpinMode spin_mode() const {
+    return spin_mode_;
+  }
+
+  /// Busy wait loop turns so far, fewer means the core idled more.
+  std::uint64_t spin_turns() const {
+    return spin_turns_;
+  }
+
+  /// Share of ticks the adaptive mode aims to wake on time, e.g. 0.99.
+  void set_lateness_percentile(double percentile) {
+    tuner_.set_percentile(percentile);
+  }
+
+private:
+  void spin_until(time_point deadline);
+  void timer_wait_until(time_point deadline);
+  void adaptive_wait_until(time_point deadline);
+
+  PacingMode mode_;
+  std::chrono::nanoseconds spin_window_ = std::chrono::milliseconds(2);
+  SpinWindowTuner tuner_;
+  SpinMode spin_mode_ = SpinMode::yield;
+  std::uint64_t spin_turns_ = 0;
+  void *timer_ = nullptr; ///< Waitable timer HANDLE, created on demand
+};
+
+/**
+ * Simulated time that only moves when slept on. Sleeping jumps straight to
+ * the deadline, so a paced loop runs as fast as the CPU allows while seeing
+ * exactly the schedule it would see in real time.
+ */
+class VirtualClock final : public Clock {
+public:
+  time_point now() override {
+    return now_;
+  }
+
+  void sleep_until(time_point deadline) override {
+    if (deadline > now_)
+      now_ = deadline;
+  }
+
+  void advance(std::chrono::nanoseconds duration) {
+    now_ += duration;
+  }
+
+private:
+  time_point now_{};
+};
+
+} // namespace excserial
@@ -0,0 +1,90 @@
+/**
+ * @file dashboard.h
+ * @brief Full screen terminal view of many ports.
+ *
+ * A low priority thread samples every port a few times a second and draws
+ * a table of frames/s, bytes/s, wake-up lateness percentiles, transmit queue
+ * depth and the last values sent. Only characters that changed since the
+ * previous refresh are rewritten, with VT cursor moves, in a single
+ * WriteFile per refresh.
+ */
+
+#pragma once
+
+#include "excserial/frame.h"
+#include "excserial/histogram.h"
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace excserial {
+
+class MultiRateScheduler;
+class Stream;
+
+/// Cumulative counters of one port, filled in by a Dashboard::Sample.
+struct PortSample {
+  std::uint64_t frames = 0;
+  std::uint64_t bytes = 0;
+  LatenessHistogram::Counts lateness{};
+  std::size_t queued_bytes = 0;
+  Values sent_values{}; ///< Written to the port, nothing is read back
+};
+
+class Dashboard {
+public:
+  /// Fills in a port's counters, called on the dashboard thread.
+  using Sample = std::function<void(PortSample &sample)>;
+
+  static constexpr std::size_t width = 100; ///< Columns drawn
+
+  Dashboard() = default;
+  ~Dashboard();
+
+  Dashboard(const Dashboard &) = delete;
+  Dashboard &operator=(const Dashboard &) = delete;
+
+  /// Adds a row. Not while running.
+  void add_port(std::string name, Sample sample);
+  /// Adds a row sampling stream, which must outlive the dashboard.
+  void add_stream(std::string name, Stream &stream);
+  /// Adds a row sampling port of scheduler, which must outlive the
+  /// dashboard.
+  void add_scheduled_port(std::string name, MultiRateScheduler &scheduler,
+                          std::size_t port);
+
+  /// Switches to the alternate screen and refreshes every period.
+  void start(std::chrono::milliseconds period);
+  /// Restores the screen the dashboard replaced.
+  void stop();
+
+private:
+  using Line = std::array<char, width>;
+
+  struct Row {
+    std::string name;
+    Sample sample;
+    PortSample last;
+  };
+
+  void run();
+  void render(std::vector<Line> &screen, double seconds);
+  void draw(const std::vector<Line> &screen,
+            const std::vector<Line> &previous, std::string &output);
+
+  std::vector<Row> rows_;
+  std::chrono::milliseconds period_{250};
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stop_requested_ = false;
+  std::thread thread_;
+};
+
+} // namespace excserial
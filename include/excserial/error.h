@@ -0,0 +1,16 @@
+/**
+ * @file error.h
+ * @brief Windows error code formatting.
+ */
+
+#pragma once
+
+#include <string>
+#include <windows.h>
+
+namespace excserial {
+
+/// Human readable message for a GetLastError() code.
+std::string error_string(DWORD error_code);
+
+} // namespace excserial
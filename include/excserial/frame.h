@@ -0,0 +1,112 @@
+/**
+ * @file frame.h
+ * @brief Frame encoding for the channel values sent to the MCU.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+
+namespace excserial {
+
+/// Number of channels in every frame.
+inline constexpr std::size_t channel_count = 4;
+
+/// One value per channel.
+using Values = std::array<std::int32_t, channel_count>;
+
+/// Longest text frame, "#" + 4 * "-2147483648" + 3 * "," + ";".
+inline constexpr std::size_t max_frame_size = 2 + channel_count * 11 + 3;
+
+/// Fixed size buffer large enough for any encoded frame.
+using FrameBuffer = std::array<char, max_frame_size>;
+
+/// Wire format of the frames.
+enum class FrameFormat {
+  text,   ///< "#a,b,c,d;", readable, up to max_frame_size bytes
+  binary, ///< Fixed binary_frame_size bytes, see encode_binary_frame()
+  /// Zigzag varint changes since the previous frame with periodic key
+  /// frames, 6 bytes when every channel moves by less than 64. Needs a
+  /// FrameEncoder, decoded by excserial_delta.h.
+  delta,
+};
+
+inline constexpr FrameFormat frame_formats[] = {
+    FrameFormat::text, FrameFormat::binary, FrameFormat::delta};
+
+std::string_view to_string(FrameFormat format);
+std::optional<FrameFormat> parse_frame_format(std::string_view name);
+
+/// Sync byte, four little-endian int32 and the XOR of those 16 bytes.
+inline constexpr std::size_t binary_frame_size = 1 + channel_count * 4 + 1;
+
+/// First byte of every binary frame.
+inline constexpr unsigned char binary_frame_sync = 0xA5;
+
+/**
+ * Encodes values as a text frame "#a,b,c,d;".
+ * @return Number of bytes written to out.
+ */
+std::size_t encode_text_frame(const Values &values,
+                              std::span<char, max_frame_size> out);
+
+/**
+ * Encodes values as a binary frame, a third of the worst case text frame.
+ * @return binary_frame_size.
+ */
+std::size_t encode_binary_frame(const Values &values,
+                                std::span<char, max_frame_size> out);
+
+/// Delta frame restating every value, see excserial_delta.h.
+std::size_t encode_key_frame(const Values &values,
+                             std::span<char, max_frame_size> out);
+
+/// Delta frame of the change from previous to values.
+std::size_t encode_step_frame(const Values &previous, const Values &values,
+                              std::span<char, max_frame_size> out);
+
+/// Encodes values in format, returns the number of bytes written to out.
+/// Delta frames come out as key frames, a FrameEncoder sends steps.
+std::size_t encode_frame(FrameFormat format, const Values &values,
+                         std::span<char, max_frame_size> out);
+
+/// Delta frames between two key frames.
+inline constexpr std::uint32_t default_keyframe_interval = 100;
+
+/**
+ * Encodes the successive frames of one stream. Only the delta format keeps
+ * state: the first frame and every keyframe_interval-th after it are key
+ * frames, the rest steps from the previous frame.
+ */
+class FrameEncoder {
+public:
+  explicit FrameEncoder(
+      FrameFormat format = FrameFormat::text,
+      std::uint32_t keyframe_interval = default_keyframe_interval);
+
+  /// @return Number of bytes written to out.
+  std::size_t encode(const Values &values,
+                     std::span<char, max_frame_size> out);
+
+  /// Makes the next frame a key frame.
+  void reset() {
+    since_key_ = 0;
+  }
+
+  FrameFormat format() const {
+    return format_;
+  }
+
+private:
+  FrameFormat format_;
+  std::uint32_t keyframe_interval_;
+  std::uint32_t since_key_ = 0; ///< Frames since the last key frame, 0 none
+  Values previous_{};
+};
+
+} // namespace excserial
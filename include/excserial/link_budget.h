@@ -0,0 +1,76 @@
+/**
+ * @file link_budget.h
+ * @brief What frame rate a serial line can carry.
+ *
+ * A rate the line can't carry doesn't fail, the driver queue just grows
+ * until writes time out or frames arrive late. Planning from the worst case
+ * frame size and the line settings catches that before the first frame.
+ */
+
+#pragma once
+
+#include "excserial/frame.h"
+#include "excserial/serial_port.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace excserial {
+
+/// Share of the line above which a rate is feasible but has no headroom for
+/// write jitter or other traffic.
+inline constexpr double link_headroom_load = 0.8;
+
+/// Bits on the line per byte: start bit, data bits, parity and stop bits.
+double bits_per_byte(const PortSettings &settings);
+
+/// Bytes per second the line settings allow.
+double line_limit(const PortSettings &settings);
+
+/// Time bytes take on a line carrying line_limit bytes per second.
+std::chrono::nanoseconds wire_time(std::size_t bytes, double line_limit);
+
+/**
+ * Longest frame values can encode to. Negated values are included when
+ * alternate, a trajectory counts every row, and without known values (e.g.
+ * shared memory input) any value is assumed. Delta frames count by their
+ * average over the busiest key frame interval, rounded up.
+ */
+std::size_t worst_frame_size(FrameFormat format, const Values *values,
+                             bool alternate,
+                             std::span<const std::int32_t> trajectory = {});
+
+struct LinkBudget {
+  FrameFormat format = FrameFormat::text;
+  std::size_t frame_bytes = 0; ///< Worst case
+  double bits_per_byte = 0.0;
+  double max_rate_hz = 0.0; ///< Frames per second the line carries
+  double rate_hz = 0.0;     ///< Requested
+  std::uint32_t baud_rate = 0;
+
+  /// Requested share of the line, above 1 the link overruns.
+  double load() const {
+    return rate_hz / max_rate_hz;
+  }
+  bool feasible() const {
+    return load() <= 1.0;
+  }
+  bool has_headroom() const {
+    return load() <= link_headroom_load;
+  }
+};
+
+LinkBudget plan_link(FrameFormat format, std::size_t frame_bytes,
+                     const PortSettings &settings, double rate_hz);
+
+/**
+ * Suggests how to get the budget within headroom: binary frames if they are
+ * shorter and enough, else the lowest standard baud rate that is, with
+ * binary frames if needed. Empty if the budget already has headroom.
+ */
+std::string link_advice(const LinkBudget &budget);
+
+} // namespace excserial
@@ -0,0 +1,241 @@
+/**
+ * @file modbus.h
+ * @brief Polling Modbus RTU slaves that only answer when asked.
+ *
+ * A Modbus RTU bus carries one request at a time: the master sends a
+ * request, the addressed slave answers, and frames are told apart only by
+ * silence on the line. The poller keeps the bus as busy as that allows. The
+ * next request is sent as soon as the response is complete and the 3.5
+ * character silence has passed, and a slave that doesn't answer costs no
+ * more than its response timeout.
+ */
+
+#pragma once
+
+#include "excserial/bus.h"
+#include "excserial/clock.h"
+#include "excserial/pacer.h"
+#include "excserial/port.h"
+#include "excserial/serial_port.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace excserial {
+
+enum class ModbusFunction : std::uint8_t {
+  read_holding_registers = 0x03,
+  read_input_registers = 0x04,
+};
+
+/// Slave, function, address, count and CRC.
+inline constexpr std::size_t modbus_request_size = 8;
+
+/// Most registers one read may ask for, the response fills a whole frame.
+inline constexpr std::uint16_t modbus_max_registers = 125;
+
+/// Longest RTU frame.
+inline constexpr std::size_t modbus_max_frame_size = 256;
+
+/// Slave, function, byte count, the registers and CRC.
+constexpr std::size_t modbus_read_response_size(std::uint16_t count) {
+  return 5 + 2 * std::size_t{count};
+}
+
+/// CRC-16/MODBUS, sent low byte first.
+std::uint16_t modbus_crc(std::span<const unsigned char> data);
+
+/**
+ * Frame gaps of a line. A frame ends after 1.5 character times of silence
+ * and frames are at least 3.5 apart. Above 19200 baud both are fixed at 750
+ * and 1750 us, as the Modbus serial line specification asks.
+ */
+struct ModbusTiming {
+  std::chrono::nanoseconds character{0};
+  std::chrono::nanoseconds end_of_frame{0}; ///< 1.5 characters
+  std::chrono::nanoseconds silence{0};      ///< 3.5 characters
+};
+
+ModbusTiming modbus_timing(const PortSettings &settings);
+
+/**
+ * Shortest time on the bus of one read of count registers: the request, the
+ * silence before the slave answers, the response and the silence before the
+ * next request. Its inverse is the highest poll rate the line allows.
+ */
+std::chrono::nanoseconds modbus_read_cycle(const PortSettings &settings,
+                                           std::uint16_t count);
+
+/// Encodes a read of count registers from address on slave.
+void encode_read_request(std::uint8_t slave, ModbusFunction function,
+                         std::uint16_t address, std::uint16_t count,
+                         std::span<char, modbus_request_size> out);
+
+/// What became of a request.
+enum class ModbusResult {
+  ok,
+  timeout,   ///< No answer within the response timeout
+  bad_frame, ///< Wrong CRC or length
+  exception, ///< The slave refused, e.g. an illegal address
+  mismatch,  ///< A valid frame from another slave or for another function
+};
+
+std::string_view to_string(ModbusResult result);
+
+/**
+ * Checks a response to a read of registers.size() registers and decodes the
+ * registers into registers.
+ * @param exception_code Set to the slave's code on ModbusResult::exception.
+ */
+ModbusResult parse_read_response(std::span<const unsigned char> response,
+                                 std::uint8_t slave, ModbusFunction function,
+                                 std::span<std::uint16_t> registers,
+                                 std::uint8_t &exception_code);
+
+/// Registers read from one slave at a fixed period.
+struct ModbusPoll {
+  std::uint8_t slave = 1;
+  ModbusFunction function = ModbusFunction::read_holding_registers;
+  std::uint16_t address = 0;
+  std::uint16_t count = 1;
+  Period period{std::chrono::milliseconds(100)};
+};
+
+struct ModbusSettings {
+  /// Time a slave has to start answering after the request has left.
+  std::chrono::nanoseconds response_timeout = std::chrono::milliseconds(50);
+  DirectionControl direction = DirectionControl::none;
+};
+
+/// One poll's outcomes since start.
+struct PollStats {
+  std::uint64_t requests = 0;
+  std::uint64_t responses = 0; ///< Valid, with registers
+  std::uint64_t timeouts = 0;
+  std::uint64_t bad_frames = 0;
+  std::uint64_t exceptions = 0;
+  std::uint64_t mismatches = 0;
+  std::uint64_t missed = 0; ///< Periods skipped because the bus was busy
+  /// Request sent to response complete, over valid responses.
+  double latency_mean_us = 0.0;
+  double latency_max_us = 0.0;
+  std::uint8_t last_exception = 0;
+};
+
+/**
+ * Polls Modbus RTU slaves from a dedicated thread. Polls are added before
+ * start(). Operations return false on failure and leave a description in
+ * error().
+ */
+class ModbusPoller {
+public:
+  ModbusPoller() = default;
+  ~ModbusPoller();
+
+  ModbusPoller(const ModbusPoller &) = delete;
+  ModbusPoller &operator=(const ModbusPoller &) = delete;
+
+  /// Paces with clock instead of the steady clock. Not owned.
+  void use_clock(Clock &clock) {
+    clock_ = &clock;
+  }
+
+  /// Wait strategy of the steady clock. Not while running.
+  void set_pacing(PacingMode mode, SpinMode spin) {
+    steady_clock_.set_mode(mode);
+    steady_clock_.set_spin_mode(spin);
+  }
+
+  /// Not while running.
+  void set_settings(const ModbusSettings &settings) {
+    settings_ = settings;
+  }
+
+  /// @return Index for stats() and registers().
+  std::size_t add_poll(const ModbusPoll &poll);
+
+  /**
+   * Starts polling on port, which must outlive the run, with the timing of
+   * line. Stops by itself after request_limit requests if not 0.
+   */
+  bool start(Port &port, const PortSettings &line,
+             std::uint64_t request_limit = 0);
+  void stop();
+
+  bool running() const {
+    return running_.load(std::memory_order_acquire);
+  }
+
+  PollStats stats(std::size_t poll) const;
+  /// Registers of the last valid response, zero before the first.
+  std::vector<std::uint16_t> registers(std::size_t poll) const;
+  /// Bytes that arrived outside any response, e.g. after a timeout.
+  std::uint64_t stray_bytes() const {
+    return stray_bytes_.load(std::memory_order_relaxed);
+  }
+  /// Time since start, as the poll thread last saw it.
+  std::chrono::nanoseconds elapsed() const {
+    return std::chrono::nanoseconds{
+        elapsed_ns_.load(std::memory_order_relaxed)};
+  }
+
+  /// Not safe to call while running().
+  const std::string &error() const {
+    return error_;
+  }
+
+private:
+  struct PollState {
+    ModbusPoll config;
+    PeriodAccumulator offset;
+    std::vector<std::uint16_t> registers; ///< Guarded by registers_mutex_
+    std::atomic<std::uint64_t> requests{0};
+    std::atomic<std::uint64_t> responses{0};
+    std::atomic<std::uint64_t> timeouts{0};
+    std::atomic<std::uint64_t> bad_frames{0};
+    std::atomic<std::uint64_t> exceptions{0};
+    std::atomic<std::uint64_t> mismatches{0};
+    std::atomic<std::uint64_t> missed{0};
+    std::atomic<std::int64_t> latency_sum_ns{0};
+    std::atomic<std::int64_t> latency_max_ns{0};
+    std::atomic<std::uint8_t> last_exception{0};
+  };
+
+  void run(std::uint64_t request_limit);
+  /// Sends one request and waits for its response.
+  bool poll(PollState &poll);
+  /// Reads until expected bytes or an exception response arrived, or the
+  /// response timeout passed. Silence only ends a frame too short to tell
+  /// which.
+  bool receive(std::size_t expected, Clock::time_point timeout);
+  /// Drops bytes nobody asked for.
+  bool discard_input();
+
+  SteadyClock steady_clock_;
+  Clock *clock_ = &steady_clock_;
+  ModbusSettings settings_;
+  ModbusTiming timing_;
+  double line_limit_ = 0.0;
+  Port *port_ = nullptr;
+  std::deque<PollState> polls_; ///< Deque, atomics can't move
+  mutable std::mutex registers_mutex_;
+  std::vector<unsigned char> response_;
+  std::vector<std::uint16_t> decoded_;
+  Clock::time_point line_free_;
+  std::thread thread_;
+  std::atomic_bool running_{false};
+  std::atomic_bool stop_requested_{false};
+  std::atomic<std::uint64_t> stray_bytes_{0};
+  std::atomic<std::int64_t> elapsed_ns_{0};
+  std::string error_;
+};
+
+} // namespace excserial
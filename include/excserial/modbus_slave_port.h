@@ -0,0 +1,84 @@
+/**
+ * @file modbus_slave_port.h
+ * @brief Simulated Modbus RTU slaves to poll without a bus.
+ */
+
+#pragma once
+
+#include "excserial/clock.h"
+#include "excserial/port.h"
+#include "excserial/serial_port.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace excserial {
+
+/**
+ * Simulated Modbus RTU slaves behind a port, for testing a poller without a
+ * bus. Each slave answers reads of registers 0 to register_count - 1,
+ * register n holding n plus the reads of its slave so far, and refuses
+ * anything else with a Modbus exception. Absent slaves stay silent.
+ * Responses arrive byte by byte at the line rate after a turnaround delay,
+ * on the clock the poller uses, so a VirtualClock gives exact and
+ * repeatable timing. A request cuts off a response that hasn't been read.
+ */
+class ModbusSlavePort final : public Port {
+public:
+  static constexpr std::uint16_t register_count = 1000;
+
+  /// Not owned.
+  ModbusSlavePort(Clock &clock, const PortSettings &line);
+
+  void add_slave(std::uint8_t address);
+
+  /// Time between the end of a request and the start of its response, at
+  /// least the 3.5 character silence.
+  void set_turnaround(std::chrono::nanoseconds turnaround) {
+    turnaround_ = turnaround;
+  }
+
+  /// Corrupts the CRC of every n-th response, 0 for none.
+  void set_corrupt_every(std::uint32_t n) {
+    corrupt_every_ = n;
+  }
+
+  /// Pauses every response for gap after its first bytes, as a USB adapter
+  /// does when its latency timer splits a frame. 0 bytes for none.
+  void set_gap(std::size_t bytes, std::chrono::nanoseconds gap) {
+    gap_after_ = bytes;
+    gap_ = gap;
+  }
+
+  bool write(std::span<const char> data) override;
+  bool read(std::span<char> out, std::size_t &received) override;
+
+  const std::string &name() const override {
+    return name_;
+  }
+  const std::string &error() const override {
+    return error_;
+  }
+
+private:
+  Clock &clock_;
+  std::chrono::nanoseconds character_;
+  std::chrono::nanoseconds silence_;
+  std::chrono::nanoseconds turnaround_;
+  std::array<std::uint32_t, 256> reads_{}; ///< Per address
+  std::array<bool, 256> present_{};
+  std::uint32_t corrupt_every_ = 0;
+  std::uint32_t responses_ = 0;
+  std::size_t gap_after_ = 0;
+  std::chrono::nanoseconds gap_{0};
+  std::vector<char> pending_;    ///< Last response
+  std::size_t pending_read_ = 0; ///< Of it, already read
+  Clock::time_point first_byte_; ///< When pending_[0] has arrived
+  std::string name_ = "simulated slaves";
+  std::string error_;
+};
+
+} // namespace excserial
@@ -0,0 +1,126 @@
+/**
+ * @file pacer.h
+ * @brief Fixed rate pacing of the send loop.
+ */
+
+#pragma once
+
+#include "excserial/clock.h"
+
+#include <chrono>
+#include <cstdint>
+
+namespace excserial {
+
+/**
+ * Exact tick period of whole + remainder / divisor nanoseconds. Rates that
+ * don't divide a second evenly, like 300 Hz, keep the fraction instead of
+ * rounding it away on every tick, so the long run rate is exact.
+ */
+class Period {
+public:
+  Period() = default;
+
+  /// A whole number of nanoseconds, implicit so durations convert.
+  Period(std::chrono::nanoseconds period);
+
+  /// numerator / denominator nanoseconds, the denominator at most 2^32.
+  Period(std::uint64_t numerator_ns, std::uint64_t denominator);
+
+  /// Period of rate_hz read to a thousandth of a hertz, at most 1 MHz.
+  static Period from_rate(double rate_hz);
+
+  /// Duration of ticks periods, rounded down to whole nanoseconds.
+  std::chrono::nanoseconds times(std::uint64_t ticks) const;
+
+  /// Rounded to the nearest nanosecond, for display.
+  std::chrono::nanoseconds rounded() const;
+
+  bool positive() const {
+    return whole_ > 0 || remainder_ > 0;
+  }
+
+private:
+  friend class PeriodAccumulator;
+
+  std::uint64_t whole_ = 1'000'000;
+  std::uint64_t remainder_ = 0; ///< Always below divisor_
+  std::uint64_t divisor_ = 1;
+};
+
+/**
+ * Running sum of a Period over ticks. The fraction below a nanosecond is
+ * carried from tick to tick like the error term of Bresenham's line
+ * algorithm, so elapsed() after n ticks equals Period::times(n) exactly.
+ */
+class PeriodAccumulator {
+public:
+  PeriodAccumulator() = default;
+  explicit PeriodAccumulator(const Period &period);
+
+  void advance();
+  void advance(std::uint64_t ticks);
+
+  /// Advances at least one tick, until elapsed() is past offset. Returns the
+  /// number of ticks advanced.
+  std::uint64_t advance_past(std::chrono::nanoseconds offset);
+
+  /// Sum of the periods so far, rounded down to whole nanoseconds.
+  std::chrono::nanoseconds elapsed() const {
+    return elapsed_;
+  }
+
+private:
+  Period period_;
+  std::chrono::nanoseconds elapsed_{0};
+  std::uint64_t fraction_ = 0; ///< Carried remainder, below the divisor
+};
+
+/**
+ * Wakes the caller once per period. Deadlines are scheduled from the previous
+ * deadline rather than the previous wake-up, so lateness on one tick does not
+ * shift every following tick. Ticks that are missed entirely are skipped,
+ * the rest stay on the original grid.
+ */
+class Pacer {
+public:
+  using time_point = Clock::time_point;
+
+  Pacer(Period period, Clock &clock);
+
+  /// Restarts the schedule, the first tick is one period after start.
+  void reset(time_point start);
+
+  /// Blocks until the next deadline and returns the wake-up time.
+  time_point wait();
+
+  /// Moves every following deadline by, to slew onto an external grid.
+  void shift(std::chrono::nanoseconds by) {
+    start_ += by;
+    next_ += by;
+  }
+
+  /// Start of the schedule, tick n is due at start + period.times(n).
+  time_point start() const {
+    return start_;
+  }
+
+  /// Deadline of the tick the last wait() returned for.
+  time_point deadline() const {
+    return deadline_;
+  }
+
+  const Period &period() const {
+    return period_;
+  }
+
+private:
+  Period period_;
+  Clock &clock_;
+  time_point start_;
+  PeriodAccumulator ticks_;
+  time_point next_;
+  time_point deadline_;
+};
+
+} // namespace excserial
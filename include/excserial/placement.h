@@ -0,0 +1,66 @@
+/**
+ * @file placement.h
+ * @brief Core and NUMA node placement of send threads.
+ *
+ * On multi-socket machines each USB or PCIe serial controller hangs off one
+ * socket. A send thread on the other socket pays for every write crossing the
+ * interconnect, so the thread and its buffers can be bound to a processor or
+ * NUMA node, or to the node the port's controller reports.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace excserial {
+
+/// Where a send thread runs, -1 leaves the choice to the OS.
+struct Placement {
+  int cpu = -1;           ///< Logical processor, counted across groups
+  int numa_node = -1;     ///< Any processor of this node
+  bool near_port = false; ///< The node of the port's controller, if known
+
+  bool requested() const {
+    return cpu >= 0 || numa_node >= 0 || near_port;
+  }
+};
+
+/// A Placement resolved against the machine and a port.
+struct PlacementInfo {
+  int cpu = -1;         ///< Pinned processor, -1 if not pinned to one
+  int thread_node = -1; ///< Node the thread is bound to, -1 if unbound
+  int port_node = -1;   ///< Node of the port's controller, -1 if unknown
+  std::uint16_t group = 0;
+  std::uint64_t mask = 0; ///< Processors of group, 0 leaves the thread alone
+
+  /// Thread and port on the same node, writes don't cross sockets.
+  bool local() const {
+    return thread_node >= 0 && thread_node == port_node;
+  }
+};
+
+int numa_node_count();
+
+/// NUMA node reported by the controller of a COM port or one of its parent
+/// devices, -1 if unknown, e.g. for a simulated port.
+int port_numa_node(std::string_view port);
+
+/**
+ * Resolves placement for a thread writing to port. Looks the port's node up
+ * only when needed or requested, so an unplaced stream stays cheap.
+ * @return false with error set for processors or nodes that don't exist.
+ */
+bool resolve_placement(const Placement &placement, std::string_view port,
+                       PlacementInfo &info, std::string &error);
+
+/// Binds the calling thread as resolved, does nothing for an empty mask.
+bool bind_current_thread(const PlacementInfo &info);
+
+/// Page aligned zeroed memory on node, or the OS's choice for node -1.
+void *allocate_on_node(std::size_t size, int node);
+void free_on_node(void *memory);
+
+} // namespace excserial
@@ -0,0 +1,47 @@
+/**
+ * @file port.h
+ * @brief Destination for encoded frames.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+
+namespace excserial {
+
+/**
+ * Anything frames can be written to: a COM port or a simulated port.
+ * Operations return false on failure and leave a description in error().
+ */
+class Port {
+public:
+  virtual ~Port() = default;
+
+  /// Writes all of data.
+  virtual bool write(std::span<const char> data) = 0;
+
+  /// Reads the bytes that have arrived, up to out.size(), without waiting
+  /// for more. Ports that can't receive never have any.
+  virtual bool read(std::span<char>, std::size_t &received) {
+    received = 0;
+    return true;
+  }
+
+  /// Bytes accepted by write() but not yet on the wire, 0 if unknown.
+  virtual std::size_t queued_bytes() {
+    return 0;
+  }
+
+  /// Raises or drops RTS, for half-duplex direction control. Ports without
+  /// one ignore it.
+  virtual bool set_rts(bool) {
+    return true;
+  }
+
+  virtual const std::string &name() const = 0;
+  virtual const std::string &error() const = 0;
+};
+
+} // namespace excserial
@@ -0,0 +1,81 @@
+/**
+ * @file reporter.h
+ * @brief Status line printing off the timing critical threads.
+ *
+ * A low priority thread reads the counters, formats them into a buffer on
+ * its own stack and rewrites the console line with a single WriteFile, so
+ * status output never allocates and never competes with the send thread.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <format>
+#include <functional>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+namespace excserial {
+
+/// Fixed size line a status is formatted into, too long output is cut.
+class StatusLine {
+public:
+  static constexpr std::size_t capacity = 200;
+
+  template <typename... Args>
+  void append(std::format_string<Args...> format, Args &&...args) {
+    const auto result =
+        std::format_to_n(data_.data() + size_,
+                         static_cast<std::ptrdiff_t>(capacity - size_), format,
+                         std::forward<Args>(args)...);
+    size_ = std::min(capacity, size_ + static_cast<std::size_t>(result.size));
+  }
+
+  void clear() {
+    size_ = 0;
+  }
+  std::string_view view() const {
+    return {data_.data(), size_};
+  }
+
+private:
+  std::array<char, capacity> data_;
+  std::size_t size_ = 0;
+};
+
+/**
+ * Renders a StatusLine every interval on its own low priority thread and
+ * overwrites the previous one on stdout. The render callback runs on that
+ * thread, so it may only read thread safe state such as atomic counters.
+ */
+class StatusReporter {
+public:
+  using Render = std::function<void(StatusLine &line)>;
+
+  StatusReporter() = default;
+  ~StatusReporter();
+
+  StatusReporter(const StatusReporter &) = delete;
+  StatusReporter &operator=(const StatusReporter &) = delete;
+
+  void start(Render render, std::chrono::milliseconds interval);
+  /// Returns once the thread is gone, the last line stays on screen.
+  void stop();
+
+private:
+  void run();
+
+  Render render_;
+  std::chrono::milliseconds interval_{0};
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stop_requested_ = false;
+  std::thread thread_;
+};
+
+} // namespace excserial
@@ -0,0 +1,218 @@
+/**
+ * @file scheduler.h
+ * @brief Several periodic streams at different rates on one thread.
+ *
+ * Each stream updates some channels of one port at its own period, e.g. axes
+ * 1 and 2 at 1 kHz and axes 3 and 4 at 50 Hz. Deadlines are kept in a
+ * timer wheel with microsecond ticks, so scheduling costs the same for one
+ * stream or a thousand. Streams due on the same tick for the same port are
+ * merged into one frame and one write, channels of streams that are not due
+ * keep their last values. With many ports the writes can be handed to a
+ * WriterPool so a slow port doesn't delay the schedule.
+ */
+
+#pragma once
+
+#include "excserial/arena.h"
+#include "excserial/clock.h"
+#include "excserial/frame.h"
+#include "excserial/histogram.h"
+#include "excserial/pacer.h"
+#include "excserial/placement.h"
+#include "excserial/port.h"
+#include "excserial/stats.h"
+#include "excserial/value_slot.h"
+#include "excserial/writer_pool.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace excserial {
+
+struct ScheduledStream {
+  std::size_t port = 0; ///< Index returned by add_port()
+  Period period{std::chrono::milliseconds(1)};
+  std::uint32_t channels = 0xF; ///< Bit mask of the channels this stream sets
+  Values values{};              ///< Initial values, only masked channels used
+  bool alternate = false;       ///< Flip the sign after every tick
+};
+
+/// Per-stream timing since start.
+struct StreamLateness {
+  std::uint64_t ticks = 0;  ///< Ticks served
+  std::uint64_t missed = 0; ///< Ticks skipped because the loop was behind
+  double mean_us = 0.0;
+  double max_us = 0.0;
+};
+
+/// Per-port output since start, readable while running.
+struct PortCounters {
+  std::uint64_t frames = 0; ///< Written, or handed to the writer pool
+  std::uint64_t bytes = 0;
+};
+
+/**
+ * Runs ScheduledStreams from a dedicated thread. Ports and streams are added
+ * before start(). Operations return false on failure and leave a
+ * description in error().
+ */
+class MultiRateScheduler {
+public:
+  MultiRateScheduler() = default;
+  ~MultiRateScheduler();
+
+  MultiRateScheduler(const MultiRateScheduler &) = delete;
+  MultiRateScheduler &operator=(const MultiRateScheduler &) = delete;
+
+  /// Paces with clock instead of the steady clock. Not owned.
+  void use_clock(Clock &clock) {
+    clock_ = &clock;
+  }
+
+  /// Wait strategy of the steady clock. Not while running.
+  void set_pacing(PacingMode mode, SpinMode spin) {
+    steady_clock_.set_mode(mode);
+    steady_clock_.set_spin_mode(spin);
+  }
+
+  /// Wire format of every port's frames, delta frames can't be combined
+  /// with the writer pool. Not while running.
+  void set_format(FrameFormat format) {
+    format_ = format;
+  }
+
+  /// Writes from a WriterPool of threads instead of the scheduler thread,
+  /// 0 sizes the pool by port count. Not while running.
+  void use_writer_pool(std::size_t threads = 0) {
+    pooled_ = true;
+    pool_threads_ = threads;
+  }
+
+  /// Processor or NUMA node of the scheduler thread, near_port means the
+  /// first port's node. Not while running.
+  void set_placement(const Placement &placement) {
+    placement_request_ = placement;
+  }
+  /// Where the scheduler thread was placed, valid after start().
+  const PlacementInfo &placement() const {
+    return placement_;
+  }
+
+  /// Not owned. @return Index for ScheduledStream::port.
+  std::size_t add_port(Port &port);
+
+  /// @return Index for update_values() and lateness().
+  std::size_t add_stream(const ScheduledStream &stream);
+
+  /// Replaces the masked channel values of a stream. Thread safe.
+  void update_values(std::size_t stream, const Values &values);
+
+  /// Starts the scheduler thread, stops by itself after tick_limit stream
+  /// ticks if not 0.
+  bool start(std::uint64_t tick_limit = 0);
+  void stop();
+
+  bool running() const {
+    return running_.load(std::memory_order_acquire);
+  }
+
+  std::vector<StreamLateness> lateness() const;
+  /// One stream's timing, without allocating.
+  StreamLateness lateness(std::size_t stream) const;
+
+  /// Port writes, fewer than ticks when streams were merged.
+  std::uint64_t writes() const {
+    return writes_.load(std::memory_order_relaxed) +
+           (pool_ ? pool_->writes() : 0);
+  }
+  PortCounters port_counters(std::size_t port) const;
+  /// Wake-up lateness of every stream tick served on port.
+  const LatenessHistogram &port_lateness(std::size_t port) const {
+    return ports_[port].lateness;
+  }
+  /// Asks the scheduler thread to sample port_telemetry() of every port
+  /// after its next writes, so the queues are queried off the reader's
+  /// thread.
+  void request_telemetry() {
+    telemetry_requested_.store(true, std::memory_order_relaxed);
+  }
+  StreamTelemetry port_telemetry(std::size_t port) const {
+    return {ports_[port].sent_values.load(),
+            ports_[port].queued_bytes.load(std::memory_order_relaxed)};
+  }
+
+  /// Frames the writer pool dropped for a newer one while the port was busy.
+  std::uint64_t dropped() const {
+    return pool_ ? pool_->dropped() : 0;
+  }
+
+  /// Heap allocations of the scheduler loop, after setup, valid once it
+  /// stopped, see count_heap_allocation(). Setup beyond the arena shows in
+  /// arena().overflow().
+  std::uint64_t heap_allocations() const {
+    return heap_allocations_.load(std::memory_order_relaxed);
+  }
+  /// Runtime memory, sized at start() on the thread's NUMA node.
+  const Arena &arena() const {
+    return arena_;
+  }
+
+  /// Not safe to call while running().
+  const std::string &error() const {
+    return error_;
+  }
+
+private:
+  struct StreamState {
+    ScheduledStream config;
+    ValueSlot values;
+    std::int32_t sign = 1;
+    std::atomic<std::uint64_t> ticks{0};
+    std::atomic<std::uint64_t> missed{0};
+    std::atomic<std::int64_t> lateness_sum_ns{0};
+    std::atomic<std::int64_t> lateness_max_ns{0};
+  };
+
+  struct PortState {
+    Port *port = nullptr;
+    Values values{}; ///< Merged values, last value of every channel
+    FrameEncoder encoder;
+    bool due = false;
+    std::atomic<std::uint64_t> frames{0};
+    std::atomic<std::uint64_t> bytes{0};
+    LatenessHistogram lateness;
+    ValueSlot sent_values;
+    std::atomic<std::size_t> queued_bytes{0};
+  };
+
+  void run(std::uint64_t tick_limit);
+
+  SteadyClock steady_clock_;
+  Clock *clock_ = &steady_clock_;
+  FrameFormat format_ = FrameFormat::text;
+  std::deque<PortState> ports_; ///< Deque, atomics can't move
+  Placement placement_request_;
+  PlacementInfo placement_;
+  bool pooled_ = false;
+  std::size_t pool_threads_ = 0;
+  std::unique_ptr<WriterPool> pool_;
+  std::deque<StreamState> streams_; ///< Deque, atomics can't move
+  std::mutex update_mutex_;
+  std::thread thread_;
+  std::atomic_bool running_{false};
+  std::atomic_bool stop_requested_{false};
+  std::atomic_bool telemetry_requested_{false};
+  std::atomic<std::uint64_t> writes_{0};
+  std::atomic<std::uint64_t> heap_allocations_{0};
+  Arena arena_;
+  std::string error_;
+};
+
+} // namespace excserial
@@ -0,0 +1,88 @@
+/**
+ * @file selftest.h
+ * @brief Host qualification: can this PC hold a given rate and jitter?
+ *
+ * Measures timer wake-up lateness for every pacing mode, the cost of reading
+ * the clock, encoding a frame and writing it, and derives the highest rate
+ * each mode sustains within a jitter budget. Also compares the frame
+ * formats on slowly changing values.
+ */
+
+#pragma once
+
+#include "excserial/clock.h"
+#include "excserial/frame.h"
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace excserial {
+
+struct SelftestOptions {
+  /// COM port to measure the write cost on, empty writes to the NUL device.
+  std::string_view port;
+  /// Highest acceptable 99th percentile wake-up lateness.
+  std::chrono::nanoseconds jitter_budget = std::chrono::microseconds(100);
+  std::chrono::nanoseconds wake_period = std::chrono::milliseconds(1);
+  int wake_samples = 500;
+  int write_samples = 2000;
+};
+
+/// Distribution of a measured duration in microseconds.
+struct LatencySummary {
+  double min_us = 0.0;
+  double p50_us = 0.0;
+  double p99_us = 0.0;
+  double max_us = 0.0;
+};
+
+struct WakeResult {
+  PacingMode mode = PacingMode::spin;
+  SpinMode spin = SpinMode::yield;
+  LatencySummary lateness;
+  double cpu_fraction = 0.0;    ///< CPU time over wall time while waiting
+  double kernel_fraction = 0.0; ///< Kernel part of it, syscalls and yields
+  /// Busy wait turns per millisecond, a power proxy: PAUSE and TPAUSE keep
+  /// the core in a low power state for most of each turn.
+  double spin_turns_per_ms = 0.0;
+};
+
+/// A frame format on a slow sine, as most setpoint channels are.
+struct FormatCost {
+  FrameFormat format = FrameFormat::text;
+  double encode_ns = 0.0;
+  double decode_ns = 0.0; ///< excserial_delta.h, delta frames only
+  double bytes_per_frame = 0.0;
+  double max_rate_hz = 0.0; ///< At 115200 baud 8N1
+};
+
+struct SelftestReport {
+  double clock_read_ns = 0.0;
+  double encode_ns = 0.0;
+  std::vector<WakeResult> wake;
+  std::vector<FormatCost> formats;
+  std::string write_target;
+  LatencySummary write;
+  std::string error; ///< Set if the write target could not be used
+};
+
+/// Sorts samples and summarizes them, samples are in nanoseconds.
+LatencySummary summarize(std::vector<std::int64_t> &samples_ns);
+
+struct CpuTimes {
+  std::chrono::nanoseconds user{0};
+  std::chrono::nanoseconds kernel{0};
+};
+
+/// CPU time used by the calling thread so far.
+CpuTimes thread_cpu_times();
+
+SelftestReport run_selftest(const SelftestOptions &options);
+
+void print_report(const SelftestReport &report,
+                  const SelftestOptions &options, std::ostream &out);
+
+} // namespace excserial
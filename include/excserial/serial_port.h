@@ -0,0 +1,80 @@
+/**
+ * @file serial_port.h
+ * @brief Windows COM port handling.
+ */
+
+#pragma once
+
+#include "excserial/port.h"
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <windows.h>
+
+namespace excserial {
+
+/// Line settings applied when the port is opened.
+struct PortSettings {
+  DWORD baud_rate = CBR_115200;
+  BYTE byte_size = 8;
+  BYTE parity = NOPARITY;
+  BYTE stop_bits = ONESTOPBIT;
+  /// RTS raised by the driver only while sending, for RS-485 transceivers
+  /// switched by RTS. Not every driver supports it.
+  bool rts_toggle = false;
+};
+
+/**
+ * Owns a COM port handle. Operations return false on failure and leave a
+ * description in error().
+ */
+class SerialPort final : public Port {
+public:
+  SerialPort() = default;
+  ~SerialPort() override;
+
+  SerialPort(const SerialPort &) = delete;
+  SerialPort &operator=(const SerialPort &) = delete;
+  SerialPort(SerialPort &&other) noexcept;
+  SerialPort &operator=(SerialPort &&other) noexcept;
+
+  /// Opens and configures the port, e.g. "COM3".
+  bool open(std::string_view name, const PortSettings &settings = {});
+
+  /// Writes all of data, blocking up to the write timeout.
+  bool write(std::span<const char> data) override;
+
+  /// Returns at once with what the driver has received.
+  bool read(std::span<char> out, std::size_t &received) override;
+
+  /// Driver transmit queue, from ClearCommError.
+  std::size_t queued_bytes() override;
+
+  /// EscapeCommFunction. Does nothing when opened with
+  /// PortSettings::rts_toggle, the driver owns RTS then.
+  bool set_rts(bool on) override;
+
+  void close();
+
+  bool is_open() const {
+    return handle_ != INVALID_HANDLE_VALUE;
+  }
+  const std::string &name() const override {
+    return name_;
+  }
+  const PortSettings &settings() const {
+    return settings_;
+  }
+  const std::string &error() const override {
+    return error_;
+  }
+
+private:
+  HANDLE handle_ = INVALID_HANDLE_VALUE;
+  std::string name_;
+  PortSettings settings_;
+  std::string error_;
+};
+
+} // namespace excserial
@@ -0,0 +1,60 @@
+/**
+ * @file shm_input.h
+ * @brief Consumer side of the shared memory value block.
+ */
+
+#pragma once
+
+#include "excserial/frame.h"
+#include "excserial_shm.h"
+
+#include <string>
+#include <string_view>
+
+namespace excserial {
+
+static_assert(EXCSERIAL_SHM_CHANNELS == channel_count,
+              "Shared memory block must match the frame channel count");
+
+/// Consistent snapshot of the shared memory block.
+struct ShmSample {
+  LONG sequence = 0; ///< 0 until the producer has published
+  Values values{};
+  LONGLONG publish_qpc = 0;
+};
+
+/// Reads values published by a producer through excserial_shm.h.
+class ShmInput {
+public:
+  ShmInput() = default;
+  ~ShmInput();
+
+  ShmInput(const ShmInput &) = delete;
+  ShmInput &operator=(const ShmInput &) = delete;
+
+  /// Creates or opens the named block and validates its layout.
+  bool open(std::string_view name);
+
+  /**
+   * Reads the block under the sequence lock. Returns false if the producer
+   * was mid-write on every attempt, sample is then left untouched so the
+   * caller keeps its previous values rather than waiting on the producer.
+   */
+  bool read(ShmSample &sample) const;
+
+  void close();
+
+  bool is_open() const {
+    return block_ != nullptr;
+  }
+  const std::string &error() const {
+    return error_;
+  }
+
+private:
+  HANDLE mapping_ = nullptr;
+  excserial_shm_block *block_ = nullptr;
+  std::string error_;
+};
+
+} // namespace excserial
@@ -0,0 +1,104 @@
+/**
+ * @file soak.h
+ * @brief Unpaced sending that keeps the link saturated for hours.
+ *
+ * Confirms the receiver keeps up with sustained full-rate input. Frames are
+ * not paced, the transmit queue is topped up to a fill level instead, so the
+ * line never idles while the sender sleeps most of the time.
+ */
+
+#pragma once
+
+#include "excserial/clock.h"
+#include "excserial/frame.h"
+#include "excserial/port.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace excserial {
+
+/// Counters of a soak run.
+struct SoakStats {
+  std::uint64_t frames = 0; ///< Frames handed to the port
+  std::uint64_t bytes = 0;  ///< Bytes handed to the port
+  std::uint64_t queued_bytes = 0; ///< Of those, still in the transmit queue
+  std::chrono::nanoseconds elapsed{0};
+  /// Lowest throughput of any full window, 0 before the first one ends.
+  double min_window_throughput = 0.0;
+
+  /// Bytes per second that left the queue since the start.
+  double throughput() const;
+};
+
+/**
+ * Keeps a port's transmit queue filled from a dedicated thread. Operations
+ * return false on failure and leave a description in error().
+ *
+ * Writes go out in blocks of half the fill level while the queue has room
+ * for one. Otherwise the thread sleeps until a block has drained at the line
+ * rate. Drivers that complete a write only once its bytes are sent keep the
+ * queue near empty, the thread then spends its time blocked in the write.
+ * Either way the line stays busy without the thread spinning.
+ */
+class SoakSender {
+public:
+  /// Throughput is also tracked per window of this length.
+  static constexpr auto window = std::chrono::seconds(10);
+
+  SoakSender() = default;
+  ~SoakSender();
+
+  SoakSender(const SoakSender &) = delete;
+  SoakSender &operator=(const SoakSender &) = delete;
+
+  /**
+   * Starts sending to port, which must outlive the run.
+   * @param line_limit Bytes per second the line carries, see line_limit().
+   * @param fill Transmit queue level to keep, as time on the line.
+   */
+  bool start(Port &port, double line_limit, std::chrono::nanoseconds fill,
+             const Values &values, bool alternate,
+             FrameFormat format = FrameFormat::text);
+
+  void stop();
+
+  /// False after stop() or a write error.
+  bool running() const {
+    return running_.load(std::memory_order_acquire);
+  }
+
+  SoakStats stats() const;
+
+  /// Not safe to call while running().
+  const std::string &error() const {
+    return error_;
+  }
+
+private:
+  void run();
+
+  Port *port_ = nullptr;
+  double line_limit_ = 0.0;
+  std::size_t fill_bytes_ = 0;
+  std::vector<char> block_; ///< Whole frames, about half the fill level
+  std::uint32_t block_frames_ = 0;
+  /// Waitable timer, a busy wait would burn the CPU this mode spares.
+  SteadyClock clock_{PacingMode::timer};
+  Clock::time_point start_;
+  std::thread thread_;
+  std::atomic_bool running_{false};
+  std::atomic_bool stop_requested_{false};
+  std::string error_;
+
+  std::atomic<std::uint64_t> blocks_{0};
+  std::atomic<std::uint64_t> queued_bytes_{0};
+  std::atomic<std::int64_t> elapsed_ns_{0};
+  std::atomic<double> min_window_{0.0};
+};
+
+} // namespace excserial
@@ -0,0 +1,38 @@
+/**
+ * @file spin.h
+ * @brief Busy waiting for the final microseconds before a deadline.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace excserial {
+
+/// What the pacer does on each turn of its busy wait.
+enum class SpinMode {
+  yield,  ///< Sleep(0), gives the core to other threads via the scheduler
+  pause,  ///< PAUSE instruction, no syscalls, eases off the sibling hyperthread
+  tpause, ///< TPAUSE light sleep until a TSC deadline, falls back to pause
+};
+
+inline constexpr SpinMode spin_modes[] = {SpinMode::yield, SpinMode::pause,
+                                          SpinMode::tpause};
+
+std::string_view to_string(SpinMode mode);
+std::optional<SpinMode> parse_spin_mode(std::string_view name);
+
+/// True if the CPU has WAITPKG (TPAUSE/UMWAIT), checked once with CPUID.
+bool tpause_supported();
+
+/**
+ * Busy waits until the steady clock reaches deadline.
+ * @return Number of loop turns, a proxy for how hard the core was driven.
+ */
+std::uint64_t spin_until(std::chrono::steady_clock::time_point deadline,
+                         SpinMode mode);
+
+} // namespace excserial
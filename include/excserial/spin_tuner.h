@@ -0,0 +1,66 @@
+/**
+ * @file spin_tuner.h
+ * @brief Learns how long the hybrid pacer has to spin.
+ *
+ * A coarse sleep overshoots by a host dependent amount. The tuner tracks a
+ * high percentile of the measured overshoot and sizes the spin window to just
+ * cover it, so the pacer spins no longer than it has to while still hitting
+ * the lateness target.
+ */
+
+#pragma once
+
+#include "excserial/histogram.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace excserial {
+
+class SpinWindowTuner {
+public:
+  /**
+   * @param percentile Share of ticks whose coarse sleep must end before the
+   *        deadline, e.g. 0.99.
+   * @param margin Added on top of the measured overshoot percentile.
+   */
+  explicit SpinWindowTuner(
+      double percentile = 0.99,
+      std::chrono::nanoseconds margin = std::chrono::microseconds(20));
+
+  /// Records how far a sleep ran past its requested wake-up time.
+  void add(std::chrono::nanoseconds overshoot);
+
+  /// Current spin window, starts conservative until samples arrive.
+  std::chrono::nanoseconds window() const {
+    return window_;
+  }
+
+  double percentile() const {
+    return percentile_;
+  }
+  void set_percentile(double percentile);
+
+  static constexpr auto min_window = std::chrono::microseconds(10);
+  static constexpr auto max_window = std::chrono::milliseconds(20);
+
+private:
+  static constexpr std::size_t bucket_count = log_buckets::count;
+  /// Older samples weigh half as much every this many samples, so the window
+  /// follows changes in host load.
+  static constexpr std::uint32_t decay_interval = 1024;
+  /// Window is recomputed every this many samples.
+  static constexpr std::uint32_t update_interval = 32;
+
+  void update_window();
+
+  double percentile_;
+  std::chrono::nanoseconds margin_;
+  std::chrono::nanoseconds window_ = std::chrono::milliseconds(2);
+  std::array<float, bucket_count> counts_{}; ///< Decaying, see log_buckets
+  float total_ = 0.0f;
+  std::uint32_t samples_ = 0;
+};
+
+} // namespace excserial
@@ -0,0 +1,43 @@
+/**
+ * @file stats.h
+ * @brief Counters reported by a running stream.
+ */
+
+#pragma once
+
+#include "excserial/frame.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace excserial {
+
+/// Snapshot of a stream's counters.
+struct StreamStats {
+  std::uint64_t frames_sent = 0;
+  std::uint64_t bytes_sent = 0;
+
+  /// Producer-to-wire latency of fresh shared memory samples, in
+  /// microseconds, since the previous snapshot. Zero count without shared
+  /// memory input.
+  std::uint32_t latency_count = 0;
+  double latency_min_us = 0.0;
+  double latency_avg_us = 0.0;
+  double latency_max_us = 0.0;
+
+  /// Global heap allocations of the send loop, after setup, known once the
+  /// stream stopped. Stays 0 unless the program counts them, see
+  /// count_heap_allocation().
+  std::uint64_t heap_allocations = 0;
+  /// Bytes the stream's arena was too small for and took from the heap
+  /// during setup, known once the stream stopped. See Arena::overflow().
+  std::size_t arena_overflow = 0;
+};
+
+/// Sampled by the send thread on request, see Stream::request_telemetry().
+struct StreamTelemetry {
+  Values sent_values{};         ///< Values of the last frame written
+  std::size_t queued_bytes = 0; ///< Port transmit queue after that write
+};
+
+} // namespace excserial
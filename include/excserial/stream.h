@@ -0,0 +1,212 @@
+/**
+ * @file stream.h
+ * @brief High-rate frame stream to one serial port.
+ *
+ * Minimal embedding example:
+ *
+ *   excserial::Stream stream;
+ *   stream.open_port("COM3");
+ *   stream.start({.rate_hz = 1000, .values = {1, 2, 3, 4}});
+ *   stream.update_values({5, 6, 7, 8});
+ *   auto stats = stream.stats();
+ *   stream.stop();
+ */
+
+#pragma once
+
+#include "excserial/arena.h"
+#include "excserial/clock.h"
+#include "excserial/frame.h"
+#include "excserial/histogram.h"
+#include "excserial/pacer.h"
+#include "excserial/placement.h"
+#include "excserial/port.h"
+#include "excserial/serial_port.h"
+#include "excserial/shm_input.h"
+#include "excserial/stats.h"
+#include "excserial/trace.h"
+#include "excserial/value_slot.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace excserial {
+
+struct StreamConfig {
+  double rate_hz = 100.0; ///< Frames per second
+  Values values{};        ///< Initial channel values
+  bool alternate = false; ///< Flip the sign of the values after every frame
+  std::string shm_name;   ///< Sample values from this shm block if not empty
+  /// Largest magnitude of shm values, larger ones are clamped so frames stay
+  /// within the link budget. 0 allows any value.
+  std::int32_t shm_range = 0;
+  FrameFormat format = FrameFormat::text;
+
+  /// How the steady clock waits between frames, see PacingMode.
+  PacingMode pacing = PacingMode::spin;
+  /// Busy wait flavour of the spinning pacing modes.
+  SpinMode spin = SpinMode::yield;
+  /// Share of frames the adaptive pacing mode aims to send on time.
+  double lateness_percentile = 0.99;
+
+  /// Rows of channel_count values, one row sent per tick instead of values.
+  /// Not copied, the memory must stay valid until the stream has stopped.
+  std::span<const std::int32_t> trajectory;
+  bool loop = false; ///< Restart the trajectory instead of stopping at its end
+
+  /// Stop after this many frames, 0 sends until stop().
+  std::uint64_t frame_count = 0;
+
+  /// Keep stage timestamps of this many recent frames, 0 disables tracing.
+  /// Stamps come from the stream's clock, like the deadlines.
+  std::size_t trace_capacity = 0;
+
+  /// Processor or NUMA node of the send thread, its runtime memory is
+  /// allocated on the same node.
+  Placement placement;
+
+  /// Put the ticks on a grid of whole UTC seconds plus multiples of the
+  /// period and slew to stay on it, see WallClockAligner. Needs the steady
+  /// clock.
+  bool align_to_wall_clock = false;
+};
+
+/**
+ * Sends frames to a serial port from a dedicated thread at a fixed rate.
+ * Operations return false on failure and leave a description in error().
+ */
+class Stream {
+public:
+  Stream() = default;
+  ~Stream();
+
+  Stream(const Stream &) = delete;
+  Stream &operator=(const Stream &) = delete;
+
+  bool open_port(std::string_view name, const PortSettings &settings = {});
+
+  /// Sends to port instead of the COM port, e.g. a CapturePort. Not owned.
+  void use_port(Port &port) {
+    port_ = &port;
+  }
+
+  /**
+   * Paces with clock instead of the steady clock. Not owned. With a
+   * VirtualClock the stream runs as fast as the CPU allows and produces the
+   * same bytes as a real-time run.
+   */
+  void use_clock(Clock &clock) {
+    clock_ = &clock;
+  }
+
+  /// Starts the send thread. The port must be open. Fails if the COM port's
+  /// line can't carry the rate, see plan_link().
+  bool start(const StreamConfig &config);
+
+  /// Replaces the values sent from the next tick on. Thread safe.
+  void update_values(const Values &values);
+
+  /// Stops the send thread, the port stays open.
+  void stop();
+
+  /// False once stopped, after the end of a trajectory or after a write
+  /// error, see error().
+  bool running() const {
+    return running_.load(std::memory_order_acquire);
+  }
+
+  /// Counters since start, latency since the previous call.
+  StreamStats stats();
+
+  std::uint64_t frames_sent() const {
+    return frames_sent_.load(std::memory_order_relaxed);
+  }
+  std::uint64_t bytes_sent() const {
+    return bytes_sent_.load(std::memory_order_relaxed);
+  }
+  /// Wake-up lateness against the deadline of every frame since start.
+  const LatenessHistogram &lateness() const {
+    return lateness_;
+  }
+
+  /// Phase of the ticks on the wall-clock grid, 0 unless aligned.
+  std::chrono::nanoseconds alignment_error() const {
+    return std::chrono::nanoseconds{
+        alignment_error_ns_.load(std::memory_order_relaxed)};
+  }
+
+  /// Asks the send thread to sample telemetry() after its next write, so
+  /// the port's queue is queried on the thread that owns the port.
+  void request_telemetry() {
+    telemetry_requested_.store(true, std::memory_order_relaxed);
+  }
+  StreamTelemetry telemetry() const {
+    return {sent_values_.load(),
+            queued_bytes_.load(std::memory_order_relaxed)};
+  }
+
+  /// Stage timestamps of recent frames, readable while running.
+  const TraceRing &trace() const {
+    return trace_;
+  }
+
+  /// Exact tick period, rounded() for display.
+  const Period &period() const {
+    return period_;
+  }
+  /// Where the send thread was placed, valid after start().
+  const PlacementInfo &placement() const {
+    return placement_;
+  }
+  const Port &port() const {
+    return *port_;
+  }
+
+  /// Not safe to call while running().
+  const std::string &error() const {
+    return error_;
+  }
+
+private:
+  void run();
+  void add_latency(std::int64_t latency_ns);
+
+  SerialPort serial_;
+  Port *port_ = &serial_;
+  SteadyClock steady_clock_;
+  Clock *clock_ = &steady_clock_;
+  ShmInput shm_;
+  StreamConfig config_;
+  PlacementInfo placement_;
+  Period period_;
+  ValueSlot values_;
+  std::mutex update_mutex_;
+  std::thread thread_;
+  std::atomic_bool running_{false};
+  std::atomic_bool stop_requested_{false};
+  std::string error_;
+  Arena arena_; ///< Trace ring and any other runtime buffers
+  TraceRing trace_;
+
+  std::atomic<std::uint64_t> frames_sent_{0};
+  std::atomic<std::uint64_t> bytes_sent_{0};
+  std::atomic<std::uint32_t> latency_count_{0};
+  std::atomic<std::int64_t> latency_sum_ns_{0};
+  std::atomic<std::int64_t> latency_min_ns_{INT64_MAX};
+  std::atomic<std::int64_t> latency_max_ns_{0};
+  std::atomic<std::uint64_t> heap_allocations_{0};
+  std::atomic<std::size_t> arena_overflow_{0};
+  LatenessHistogram lateness_;
+  std::atomic<std::int64_t> alignment_error_ns_{0};
+  std::atomic_bool telemetry_requested_{false};
+  ValueSlot sent_values_;
+  std::atomic<std::size_t> queued_bytes_{0};
+};
+
+} // namespace excserial
@@ -0,0 +1,83 @@
+/**
+ * @file timer_wheel.h
+ * @brief Hierarchical timer wheel for stream deadlines.
+ *
+ * Five levels of 64 slots cover 2^30 ticks, each level with an occupancy
+ * bitmap and the earliest expiry of every slot, so the next expiry is found
+ * with a handful of bit scans instead of walking empty slots. Scheduling,
+ * finding the next expiry and expiring all cost O(1) in the number of timers;
+ * a timer is moved down at most once per level. Timers further out than the
+ * wheel covers wait in an overflow list.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+#include <vector>
+
+namespace excserial {
+
+class TimerWheel {
+public:
+  static constexpr unsigned slot_bits = 6;
+  static constexpr unsigned slot_count = 1u << slot_bits;
+  static constexpr unsigned level_count = 5;
+
+  /// Timer ids are 0 to capacity - 1, each pending at most once. Per-timer
+  /// state is allocated from memory.
+  explicit TimerWheel(
+      std::size_t capacity = 0,
+      std::pmr::memory_resource *memory = std::pmr::get_default_resource());
+
+  /// Makes room for ids up to capacity - 1. Not while timers are pending.
+  void reserve(std::size_t capacity);
+
+  /// Arms timer id to expire at tick, at once if tick is not after now().
+  void schedule(std::uint32_t id, std::uint64_t tick);
+
+  /// Earliest pending expiry, nullopt if no timer is pending.
+  std::optional<std::uint64_t> next_expiry() const;
+
+  /// Moves time forward to tick and appends the ids of all expired timers
+  /// to expired, earliest first. Reserve room for all timers in expired to
+  /// keep this free of allocations.
+  void advance(std::uint64_t tick, std::pmr::vector<std::uint32_t> &expired);
+
+  std::uint64_t now() const {
+    return now_;
+  }
+  std::size_t size() const {
+    return size_;
+  }
+
+private:
+  static constexpr std::uint32_t none = UINT32_MAX;
+
+  static constexpr unsigned span_bits = level_count * slot_bits;
+
+  struct List {
+    std::uint32_t head = none;
+    std::uint64_t earliest = UINT64_MAX;
+  };
+
+  void place(std::uint32_t id);
+  void push(List &list, std::uint32_t id);
+  void cascade(unsigned level, unsigned slot);
+  void refresh_overflow();
+  void expire_now(std::pmr::vector<std::uint32_t> &expired);
+
+  std::uint64_t now_ = 0;
+  std::size_t size_ = 0;
+  std::pmr::vector<std::uint64_t> expiry_;
+  std::pmr::vector<std::uint32_t> next_; ///< Intrusive singly linked lists
+  std::array<std::array<List, slot_count>, level_count> slots_{};
+  std::array<std::uint64_t, level_count> occupied_{};
+  List due_;      ///< Expire at now_
+  List overflow_; ///< Beyond the wheel's range
+  std::uint64_t overflow_span_ = 0; ///< now_ >> span_bits at last refresh
+};
+
+} // namespace excserial
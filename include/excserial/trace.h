@@ -0,0 +1,100 @@
+/**
+ * @file trace.h
+ * @brief Per-frame stage timestamps for jitter attribution.
+ *
+ * The send thread stamps every frame at each stage into its own ring buffer.
+ * The ring can be exported at any time in Chrome trace format, which loads in
+ * chrome://tracing and Perfetto, to see whether a late frame was held up by
+ * the scheduler, by encoding or by the driver.
+ */
+
+#pragma once
+
+#include "excserial/clock.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <ostream>
+#include <vector>
+
+namespace excserial {
+
+/// Stages of one frame, in the order they happen.
+enum class TraceStage : std::uint8_t {
+  wake,         ///< Pacer returned
+  generate,     ///< Values picked
+  encode,       ///< Frame encoded
+  write_enter,  ///< Write called
+  write_return, ///< Write returned
+  count
+};
+
+/// Timestamps of one frame in nanoseconds of the clock pacing it, so they
+/// compare with the deadline under a VirtualClock too.
+struct FrameTrace {
+  std::uint64_t frame = 0;
+  std::int64_t deadline_ns = 0; ///< When the pacer should have woken
+  std::array<std::int64_t, static_cast<std::size_t>(TraceStage::count)>
+      stamps_ns{};
+
+  void stamp(TraceStage stage, Clock::time_point now) {
+    stamps_ns[static_cast<std::size_t>(stage)] =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            now.time_since_epoch())
+            .count();
+  }
+};
+
+/**
+ * Fixed size ring of the newest frame traces. Written by one thread without
+ * locks or allocation, read from any thread. Each slot carries a sequence so
+ * a reader skips slots that are being overwritten.
+ */
+class TraceRing {
+public:
+  /// Allocates room for capacity frames, rounded up to a power of two, from
+  /// memory. Zero disables tracing. Not safe while a writer is active.
+  void reset(std::size_t capacity, std::pmr::memory_resource *memory =
+                                       std::pmr::get_default_resource());
+
+  /// Bytes reset() allocates for capacity frames.
+  static std::size_t bytes_needed(std::size_t capacity);
+
+  bool enabled() const {
+    return mask_ != 0;
+  }
+
+  /// Writer: slot for the next frame, finish with commit().
+  FrameTrace &begin(std::uint64_t frame);
+  void commit();
+
+  /// Reader: consistent copies of the buffered frames, oldest first.
+  std::vector<FrameTrace> snapshot() const;
+
+  /// Reader: writes the buffered frames as Chrome trace JSON.
+  void write_chrome_trace(std::ostream &out) const;
+
+private:
+  struct Slot {
+    std::atomic<std::uint64_t> sequence{0};
+    FrameTrace trace;
+  };
+
+  struct FreeSlots {
+    std::pmr::memory_resource *memory;
+    std::size_t count;
+
+    void operator()(Slot *slots) const;
+  };
+
+  std::unique_ptr<Slot[], FreeSlots> slots_;
+  std::size_t mask_ = 0;
+  std::atomic<std::uint64_t> head_{0};
+};
+
+} // namespace excserial
@@ -0,0 +1,50 @@
+/**
+ * @file value_slot.h
+ * @brief Lock-free single-writer slot for the current channel values.
+ */
+
+#pragma once
+
+#include "excserial/frame.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace excserial {
+
+/**
+ * Sequence lock around one set of channel values. The writer never blocks the
+ * reader, the reader retries if it raced a write. Only one thread may store
+ * at a time.
+ */
+class ValueSlot {
+public:
+  void store(const Values &values) {
+    const auto sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (std::size_t i = 0; i < channel_count; ++i)
+      values_[i].store(values[i], std::memory_order_relaxed);
+    sequence_.store(sequence + 2, std::memory_order_release);
+  }
+
+  Values load() const {
+    Values values;
+    std::uint32_t before;
+    std::uint32_t after;
+    do {
+      before = sequence_.load(std::memory_order_acquire);
+      for (std::size_t i = 0; i < channel_count; ++i)
+        values[i] = values_[i].load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      after = sequence_.load(std::memory_order_relaxed);
+    } while (before != after || (before & 1));
+    return values;
+  }
+
+private:
+  std::atomic<std::uint32_t> sequence_{0};
+  std::array<std::atomic<std::int32_t>, channel_count> values_{};
+};
+
+} // namespace excserial
@@ -0,0 +1,58 @@
+/**
+ * @file wall_clock.h
+ * @brief Aligning the tick schedule to wall-clock seconds.
+ *
+ * Frames sent on a shared time grid can be correlated with other instruments
+ * that follow the same clock, e.g. through NTP or PTP disciplining the
+ * system time.
+ */
+
+#pragma once
+
+#include "excserial/clock.h"
+#include "excserial/pacer.h"
+
+#include <chrono>
+#include <cstdint>
+
+namespace excserial {
+
+/// UTC since the Unix epoch, GetSystemTimePreciseAsFileTime in 100 ns steps.
+std::chrono::nanoseconds wall_clock_now();
+
+/**
+ * Keeps a schedule on a grid of whole UTC seconds plus multiples of the
+ * period. The offset of the wall clock to the steady clock is sampled once
+ * per tick and low pass filtered, and the schedule is slewed towards the grid
+ * by at most max_slew of a period per tick. Stepping or disciplining the
+ * system clock therefore never makes the ticks jump.
+ */
+class WallClockAligner {
+public:
+  /// Slew limit as a share of the period, the rate NTP slews at.
+  static constexpr double max_slew = 500e-6;
+
+  /// Steady time of the next whole UTC second, the schedule's start.
+  Clock::time_point start(const Period &period);
+
+  /// Samples the clock offset and returns how far to move a schedule that
+  /// currently starts at schedule_start.
+  std::chrono::nanoseconds update(Clock::time_point schedule_start);
+
+  /// Filtered phase of the ticks on the grid, positive when they are late.
+  std::chrono::nanoseconds error() const {
+    return std::chrono::nanoseconds{error_ns_};
+  }
+
+private:
+  /// Reads both clocks back to back, false if preempted in between.
+  static bool sample_offset(std::int64_t &offset_ns);
+
+  std::int64_t period_ns_ = 0;
+  std::int64_t max_step_ns_ = 1;
+  std::int64_t origin_ns_ = 0; ///< UTC of the grid origin
+  std::int64_t offset_ns_ = 0; ///< Filtered UTC minus steady time
+  std::int64_t error_ns_ = 0;
+};
+
+} // namespace excserial
@@ -0,0 +1,105 @@
+/**
+ * @file writer_pool.h
+ * @brief Few threads writing to many ports.
+ *
+ * A thread per port wastes memory and context switches once there are dozens
+ * of ports, while one thread for all of them lets a single stalled port hold
+ * up every other. The pool runs a handful of writer threads, each with its
+ * own deque of port tasks. Frames are queued on the port's home thread and
+ * idle threads steal from the others, so a thread blocked in one port's
+ * write never delays the rest, and idle threads sleep.
+ */
+
+#pragma once
+
+#include "excserial/frame.h"
+#include "excserial/port.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <semaphore>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace excserial {
+
+/**
+ * Writes frames to a fixed set of ports from a pool of threads. Every port
+ * is written by at most one thread at a time, in submission order. While a
+ * port is busy only its newest frame is kept: older ones are dropped and
+ * counted, as a late setpoint is worth less than the next one.
+ */
+class WriterPool {
+public:
+  /// Ports are not owned and must outlive the pool. A thread count of 0
+  /// picks one thread per 16 ports, at most one per core.
+  explicit WriterPool(std::span<Port *const> ports, std::size_t threads = 0);
+  ~WriterPool();
+
+  WriterPool(const WriterPool &) = delete;
+  WriterPool &operator=(const WriterPool &) = delete;
+
+  /// Queues data for port, which is an index into the ports given at
+  /// construction. Never blocks on I/O.
+  void submit(std::size_t port, std::span<const char> data);
+
+  /// Waits for queued frames to be written and joins the threads.
+  void stop();
+
+  std::size_t thread_count() const {
+    return workers_.size();
+  }
+  std::uint64_t writes() const;
+  /// Frames replaced by a newer one before their port was free.
+  std::uint64_t dropped() const;
+
+  /// True once any write failed, error() then describes the first failure.
+  bool failed() const {
+    return failed_.load(std::memory_order_acquire);
+  }
+  /// Only safe to read once failed() is true.
+  const std::string &error() const {
+    return error_;
+  }
+
+private:
+  struct PortSlot {
+    Port *port = nullptr;
+    std::mutex mutex; ///< Guards frame, size, has_frame and queued
+    FrameBuffer frame;
+    std::size_t size = 0;
+    bool has_frame = false;
+    bool queued = false; ///< In a deque or being written
+    std::atomic<std::uint64_t> writes{0};
+    std::atomic<std::uint64_t> dropped{0};
+  };
+
+  /// Fixed ring used as a deque, sized at construction so queuing never
+  /// allocates. A port is queued at most once, so one slot per port will do.
+  struct Worker {
+    std::mutex mutex;
+    /// Owner pops the back, thieves the front
+    std::vector<std::uint32_t> tasks;
+    std::size_t first = 0;
+    std::size_t count = 0;
+    std::thread thread;
+  };
+
+  void run(std::size_t self);
+  bool take(std::size_t self, std::uint32_t &port);
+  void drain(std::uint32_t port);
+
+  std::vector<std::unique_ptr<PortSlot>> ports_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::counting_semaphore<> work_{0}; ///< One release per queued task
+  std::atomic_bool stopping_{false};
+  std::atomic_bool failed_{false};
+  std::once_flag error_once_;
+  std::string error_;
+};
+
+} // namespace excserial
@@ -0,0 +1,141 @@
+/**
+ * @file excserial_delta.h
+ * @brief Reference decoder for delta frames, for the receiving firmware.
+ *
+ * Delta frames ("excserial COM3 10 1000 --format delta") send only the change
+ * of each channel since the previous frame, so slowly changing channels cost
+ * a byte each. Every frame is
+ *
+ *   header   EXCSERIAL_DELTA_KEY or EXCSERIAL_DELTA_STEP
+ *   4 x      zigzag varint, the value (key frame) or its change (step frame)
+ *   check    XOR of the header and every varint byte
+ *
+ * A varint is 7 bits per byte, least significant group first, the high bit
+ * set on every byte but the last. Zigzag maps 0, -1, 1, -2, ... to 0, 1, 2,
+ * 3, ... so small changes of either sign stay short. Changes wrap around in
+ * 32 bits. Key frames restate every value periodically, after a bad check
+ * byte the decoder drops step frames until the next key frame.
+ *
+ * Plain C99 without platform headers, usage from a UART receive interrupt:
+ *
+ *   static excserial_delta_decoder decoder;  // excserial_delta_init() once
+ *   int32_t values[EXCSERIAL_DELTA_CHANNELS];
+ *   if (excserial_delta_feed(&decoder, byte, values))
+ *     apply_setpoints(values);
+ */
+
+#ifndef EXCSERIAL_DELTA_H
+#define EXCSERIAL_DELTA_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EXCSERIAL_DELTA_CHANNELS 4
+#define EXCSERIAL_DELTA_KEY 0xA6u  /* Frame of absolute values */
+#define EXCSERIAL_DELTA_STEP 0xA7u /* Frame of changes */
+/* Longest frame: header, 5 bytes per varint and the check byte. */
+#define EXCSERIAL_DELTA_MAX_SIZE (2 + EXCSERIAL_DELTA_CHANNELS * 5)
+
+typedef struct excserial_delta_decoder {
+  int32_t values[EXCSERIAL_DELTA_CHANNELS]; /* Last decoded frame */
+  uint32_t varint;   /* Varint being read */
+  uint8_t shift;     /* Bits of it read so far */
+  uint8_t channel;   /* Channel of the varint being read */
+  uint8_t header;    /* 0 while looking for a header */
+  uint8_t check;     /* XOR so far */
+  uint8_t have_key;  /* values hold a key frame, steps can apply */
+  uint32_t frames;   /* Frames decoded */
+  uint32_t errors;   /* Frames dropped for a bad check or varint */
+  int32_t pending[EXCSERIAL_DELTA_CHANNELS]; /* Values of the frame read */
+} excserial_delta_decoder;
+
+static inline void excserial_delta_init(excserial_delta_decoder *decoder) {
+  for (int i = 0; i < EXCSERIAL_DELTA_CHANNELS; ++i) {
+    decoder->values[i] = 0;
+    decoder->pending[i] = 0;
+  }
+  decoder->varint = 0;
+  decoder->shift = 0;
+  decoder->channel = 0;
+  decoder->header = 0;
+  decoder->check = 0;
+  decoder->have_key = 0;
+  decoder->frames = 0;
+  decoder->errors = 0;
+}
+
+static inline int32_t excserial_delta_unzigzag(uint32_t value) {
+  return (int32_t)((value >> 1) ^ (0u - (value & 1u)));
+}
+
+/* Drops the frame being read and looks for the next key frame. */
+static inline void excserial_delta_resync(excserial_delta_decoder *decoder) {
+  decoder->header = 0;
+  decoder->have_key = 0;
+  decoder->errors += 1;
+}
+
+/*
+ * Feeds one received byte. Returns 1 and fills values once a frame is
+ * complete and valid, 0 otherwise.
+ */
+static inline int
+excserial_delta_feed(excserial_delta_decoder *decoder, uint8_t byte,
+                     int32_t values[EXCSERIAL_DELTA_CHANNELS]) {
+  if (decoder->header == 0) {
+    /* Steps are meaningless without the key frame they build on */
+    if (byte == EXCSERIAL_DELTA_KEY ||
+        (byte == EXCSERIAL_DELTA_STEP && decoder->have_key)) {
+      decoder->header = byte;
+      decoder->check = byte;
+      decoder->channel = 0;
+      decoder->varint = 0;
+      decoder->shift = 0;
+    }
+    return 0;
+  }
+
+  if (decoder->channel == EXCSERIAL_DELTA_CHANNELS) {
+    const uint8_t header = decoder->header;
+    decoder->header = 0;
+    if (byte != decoder->check) {
+      excserial_delta_resync(decoder);
+      return 0;
+    }
+    for (int i = 0; i < EXCSERIAL_DELTA_CHANNELS; ++i) {
+      if (header == EXCSERIAL_DELTA_KEY)
+        decoder->values[i] = decoder->pending[i];
+      else
+        decoder->values[i] = (int32_t)((uint32_t)decoder->values[i] +
+                                       (uint32_t)decoder->pending[i]);
+      values[i] = decoder->values[i];
+    }
+    decoder->have_key = 1;
+    decoder->frames += 1;
+    return 1;
+  }
+
+  decoder->check ^= byte;
+  decoder->varint |= (uint32_t)(byte & 0x7Fu) << decoder->shift;
+  decoder->shift += 7;
+  if (byte & 0x80u) {
+    /* 32 bits take at most 5 bytes */
+    if (decoder->shift >= 35)
+      excserial_delta_resync(decoder);
+    return 0;
+  }
+  decoder->pending[decoder->channel++] =
+      excserial_delta_unzigzag(decoder->varint);
+  decoder->varint = 0;
+  decoder->shift = 0;
+  return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EXCSERIAL_DELTA_H */
@@ -0,0 +1,125 @@
+/**
+ * @file excserial_shm.h
+ * @brief Shared-memory value block for co-located producers.
+ *
+ * A producer on the same host publishes setpoints into a named shared memory
+ * block and excserial samples it every tick without any syscalls. The block
+ * is protected by a sequence lock: the sequence is odd while the producer is
+ * writing and even when the values are consistent.
+ *
+ * Usage from a producer (C or C++):
+ *
+ *   HANDLE mapping;
+ *   excserial_shm_block *block = excserial_shm_open("sim", &mapping);
+ *   int32_t values[EXCSERIAL_SHM_CHANNELS] = {10, 20, 30, 40};
+ *   excserial_shm_publish(block, values);
+ *   ...
+ *   excserial_shm_close(block, mapping);
+ *
+ * and run "excserial COM3 0 1000 --shm sim".
+ */
+
+#ifndef EXCSERIAL_SHM_H
+#define EXCSERIAL_SHM_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <windows.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EXCSERIAL_SHM_MAGIC 0x53435845u /* "EXCS" */
+#define EXCSERIAL_SHM_VERSION 1u
+#define EXCSERIAL_SHM_CHANNELS 4
+#define EXCSERIAL_SHM_NAME_MAX 128
+/* How long the side that didn't create the block waits for its header. */
+#define EXCSERIAL_SHM_OPEN_WAIT_MS 1000
+
+typedef struct excserial_shm_block {
+  /* Written last by the creator, 0 until the header is complete. */
+  uint32_t magic;
+  uint32_t version;
+  /* Odd while a write is in progress. Only touched with Interlocked ops. */
+  volatile LONG sequence;
+  int32_t values[EXCSERIAL_SHM_CHANNELS];
+  /* QueryPerformanceCounter() at publish, used for latency measurement. */
+  volatile LONGLONG publish_qpc;
+} excserial_shm_block;
+
+/* Builds the kernel object name for a block, e.g. "Local\excserial.sim". */
+static inline void excserial_shm_object_name(const char *name, char *out,
+                                             size_t out_size) {
+  snprintf(out, out_size, "Local\\excserial.%s", name);
+}
+
+/*
+ * Creates or opens the named block. Either side may start first, the one
+ * that opens an existing block waits up to EXCSERIAL_SHM_OPEN_WAIT_MS for
+ * the creator to finish the header. Returns NULL on failure, the mapping
+ * handle is stored in *mapping.
+ */
+static inline excserial_shm_block *excserial_shm_open(const char *name,
+                                                      HANDLE *mapping) {
+  char object_name[EXCSERIAL_SHM_NAME_MAX];
+  excserial_shm_object_name(name, object_name, sizeof(object_name));
+
+  *mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0,
+                                (DWORD)sizeof(excserial_shm_block),
+                                object_name);
+  if (*mapping == NULL)
+    return NULL;
+  const int created = GetLastError() != ERROR_ALREADY_EXISTS;
+
+  excserial_shm_block *block = (excserial_shm_block *)MapViewOfFile(
+      *mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(excserial_shm_block));
+  if (block == NULL) {
+    CloseHandle(*mapping);
+    *mapping = NULL;
+    return NULL;
+  }
+
+  /* Fresh mappings are zero filled, only the header needs setting. The
+     magic goes last with a full barrier, so a block with a magic has its
+     version too. */
+  if (created) {
+    block->version = EXCSERIAL_SHM_VERSION;
+    InterlockedExchange((volatile LONG *)&block->magic,
+                        (LONG)EXCSERIAL_SHM_MAGIC);
+    return block;
+  }
+  const ULONGLONG deadline = GetTickCount64() + EXCSERIAL_SHM_OPEN_WAIT_MS;
+  while (InterlockedCompareExchange((volatile LONG *)&block->magic, 0, 0) ==
+             0 &&
+         GetTickCount64() < deadline)
+    Sleep(1);
+  return block;
+}
+
+static inline void excserial_shm_close(excserial_shm_block *block,
+                                       HANDLE mapping) {
+  if (block != NULL)
+    UnmapViewOfFile(block);
+  if (mapping != NULL)
+    CloseHandle(mapping);
+}
+
+/* Publishes a full set of channel values. Single producer only. */
+static inline void excserial_shm_publish(
+    excserial_shm_block *block,
+    const int32_t values[EXCSERIAL_SHM_CHANNELS]) {
+  LARGE_INTEGER qpc;
+  InterlockedIncrement(&block->sequence); /* Odd, full barrier */
+  for (int i = 0; i < EXCSERIAL_SHM_CHANNELS; ++i)
+    block->values[i] = values[i];
+  QueryPerformanceCounter(&qpc);
+  block->publish_qpc = qpc.QuadPart;
+  InterlockedIncrement(&block->sequence); /* Even, full barrier */
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EXCSERIAL_SHM_H */
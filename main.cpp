@@ -5,12 +5,108 @@
  * Simple app that sends serial data on a windows computer.
  * Usage: excserial COM3 10 500
  * Sends 10 pulses alternating +/- with 500 Hz to COM3
+ *
+ * Usage: excserial COM3 0 250 --shm sim --range 1000
+ * Sends the values published by a co-located producer in the shared memory
+ * block "sim" (see excserial_shm.h) with 250 Hz to COM3. --range bounds them
+ * to +/-1000 for the link budget, without it any value is assumed
+ *
+ * Usage: excserial sim 10 500 --virtual 600
+ * Runs 600 s of the stream in virtual time against a simulated port and
+ * prints a hash of the bytes that would have been sent. With --expect-hash
+ * and --min-rate the run fails on a different byte stream or if fewer frames
+ * per second than given were generated.
+ *
+ * Usage: excserial COM3 10 1000 --format binary --baud 230400
+ * Sends fixed 18 byte binary frames at 230400 baud. Rates the line can't
+ * carry are refused with a suggestion of a format or baud rate that can.
+ * --format delta sends only the change of each value, a few bytes per frame
+ * for slowly changing values, decoded by excserial_delta.h
+ *
+ * Usage: excserial COM3 10 100 --device 1 --device 2@250:1 --rts manual
+ * Treats COM3 as an RS-485 bus: addressed frames to device 1 at 100 Hz and
+ * device 2 at 250 Hz, due frames sharing one transmission with RTS raised
+ * around it. --bus-policy priority serves higher priorities first and
+ * --turnaround sets the idle time between transmissions
+ *
+ * Usage: excserial COM3 0 100 --poll 1 --poll 2@50 --registers 100+8
+ * Polls Modbus RTU slaves 1 at 100 Hz and 2 at 50 Hz for 8 holding
+ * registers from address 100, one request on the bus at a time, and reports
+ * responses, timeouts and latency per slave. With --virtual the slaves are
+ * simulated. The value is unused
+ *
+ * Usage: excserial COM3 10 500 --trace trace.json
+ * Also records stage timestamps of the last 65536 frames and writes them as
+ * Chrome trace JSON on exit
+ *
+ * Usage: excserial COM3 10 500 --pacing hybrid
+ * Waits between frames with spin (default), sleep, hybrid, timer or adaptive.
+ * Adaptive learns the sleep overshoot and spins only as long as needed to
+ * send --lateness-percentile (default 99) percent of frames on time. The
+ * busy wait yields (default), spins on PAUSE or naps with TPAUSE (--spin)
+ *
+ * Usage: excserial COM3 10 50 --stream 12@1000 --baud 230400
+ * Sends channels 1 and 2 alternating at 1000 Hz and channels 3 and 4 at 50 Hz,
+ * merged into one frame whenever both are due
+ *
+ * Usage: excserial COM3,COM4 10 50 --stream 12@1000 --writers 2 --baud 230400
+ * Sends the same streams to both ports, written by 2 writer threads so a
+ * stalled port holds up no other
+ *
+ * Usage: excserial COM3 10 500 --dashboard 4
+ * Replaces the status line with a full screen view of rate, lateness
+ * percentiles, transmit queue and sent values, refreshed 4 times a second.
+ * With a port list and --stream it shows one row per port
+ *
+ * Usage: excserial COM3 10 0 --burst 50x10@100 --baud 921600
+ * Sends 10 bursts of 50 frames back to back, 100 ms apart, and compares the
+ * throughput on the wire to what the baud rate allows. The rate is unused
+ *
+ * Usage: excserial COM3 10 0 --soak 20
+ * Sends without pacing for as long as it runs, keeping 20 ms worth of bytes
+ * in the transmit queue, and reports the sustained throughput against the
+ * baud rate limit. The rate is unused
+ *
+ * Usage: excserial COM3 10 500 --align utc
+ * Sends on a grid of whole UTC seconds plus multiples of the period, slewing
+ * gently when the system clock is adjusted
+ *
+ * Usage: excserial COM3 10 500 --numa-node port
+ * Binds the send thread and its buffers to the NUMA node the port's
+ * controller hangs off, --cpu 12 pins it to one processor instead
+ *
+ * Usage: excserial selftest [COM3] [--jitter-budget 50]
+ * Measures wake-up latency per pacing mode, clock read, encode and write cost
+ * and prints the highest rate each mode holds within the jitter budget
  */
 
+#include "excserial/args.h"
+#include "excserial/burst.h"
+#include "excserial/bus.h"
+#include "excserial/capture_port.h"
+#include "excserial/clock.h"
+#include "excserial/dashboard.h"
+#include "excserial/reporter.h"
+#include "excserial/error.h"
+#include "excserial/link_budget.h"
+#include "excserial/modbus.h"
+#include "excserial/modbus_slave_port.h"
+#include "excserial/scheduler.h"
+#include "excserial/selftest.h"
+#include "excserial/serial_port.h"
+#include "excserial/soak.h"
+#include "excserial/stream.h"
+
+#include <atomic>
+#include <cmath>
 #include <chrono>
+#include <cstdlib>
+#include <deque>
 #include <format>
+#include <fstream>
 #include <iostream>
 #include <thread>
+#include <vector>
 #include <windows.h>
 
 using namespace std::chrono_literals;
@@ -31,162 +127,974 @@ BOOL WINAPI CtrlHandler(DWORD ctrlType) {
   }
 }
 
-inline std::string error_string(DWORD error_code) {
-  char *buffer = nullptr;
-  const DWORD len = ::FormatMessageA(
-      FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM |
-          FORMAT_MESSAGE_IGNORE_INSERTS,
-      nullptr, error_code, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
-      reinterpret_cast<char *>(&buffer), 0, nullptr);
-
-  if (len == 0 || buffer == nullptr)
-    return "Unknown error (" + std::to_string(error_code) + ")";
-
-  std::string result{buffer};
-  ::LocalFree(buffer);
-  // Remove trailing CRLF
-  while (!result.empty() && (result.back() == '\r' || result.back() == '\n'))
-    result.pop_back();
-  return result;
+/// Channel list of a stream mask, "1 2" for 0b0011.
+std::string channel_names(std::uint32_t channels) {
+  std::string names;
+  for (std::size_t channel = 0; channel < excserial::channel_count;
+       ++channel) {
+    if (channels & (1u << channel)) {
+      if (!names.empty())
+        names += ' ';
+      names += static_cast<char>('1' + channel);
+    }
+  }
+  return names;
 }
 
-int main(int argc, char *argv[]) {
-  if (argc < 4) {
-    std::cout << "Usage: excserial COM3 10 500 [Pulses with 10 pulses "
-                 "alternating +/- at 500 Hz]"
+/// Startup summary of --cpu and --numa-node.
+void print_placement(const excserial::PlacementInfo &info,
+                     std::string_view port) {
+  if (info.mask == 0 && info.port_node < 0) {
+    std::cout << std::format("{} reports no NUMA node, thread left unbound",
+                             port)
               << std::endl;
-    return EXIT_SUCCESS;
+    return;
   }
+  std::string thread = "Send thread unbound";
+  if (info.cpu >= 0)
+    thread = std::format("Send thread on CPU {}", info.cpu);
+  else if (info.thread_node >= 0)
+    thread = std::format("Send thread on NUMA node {}", info.thread_node);
+  if (info.cpu >= 0 && info.thread_node >= 0)
+    thread += std::format(" (node {})", info.thread_node);
 
-  std::cout << "Starting excserial program..." << std::endl;
+  std::string traffic = "node unknown";
+  if (info.port_node >= 0) {
+    traffic = std::format("on node {}, {}", info.port_node,
+                          info.local() ? "no cross-node traffic"
+                                       : "writes cross nodes");
+  }
+  std::cout << std::format("{}, {} {} ({} nodes)", thread, port, traffic,
+                           excserial::numa_node_count())
+            << std::endl;
+}
 
-  // Validate the input
-  int n; // Number to sent each iteration
-  {
-    std::stringstream ss(argv[2]);
-    ss >> n;
-    if (!ss) {
-      std::cerr << std::format("Can't convert arg {} to number!",
-                               std::string_view(argv[2]))
+/**
+ * Prints what the line carries at the requested rate and, without headroom,
+ * what would help. @return false if the line can't carry the rate.
+ */
+bool check_link(const excserial::LinkBudget &budget) {
+  std::cout << std::format("Link: {} byte {} frames, {:.1f} bits per byte, "
+                           "up to {:.0f} Hz at {} baud, {:.0f}% used",
+                           budget.frame_bytes, to_string(budget.format),
+                           budget.bits_per_byte, budget.max_rate_hz,
+                           budget.baud_rate, budget.load() * 100.0)
+            << std::endl;
+  if (budget.has_headroom())
+    return true;
+  const auto advice = excserial::link_advice(budget);
+  if (!budget.feasible()) {
+    std::cerr << std::format("The line can't carry {} Hz, {}",
+                             budget.rate_hz, advice)
+              << std::endl;
+    return false;
+  }
+  std::cout << std::format("Warning: little headroom for write jitter, {}",
+                           advice)
+            << std::endl;
+  return true;
+}
+
+/// Fails a virtual run that generated frames slower than --min-rate.
+bool check_min_rate(std::uint64_t frames,
+                    std::chrono::duration<double> wall_time,
+                    double min_rate) {
+  const double rate = static_cast<double>(frames) / wall_time.count();
+  if (rate < min_rate) {
+    std::cerr << std::format("Generated {:.0f} frames/s, below {:.0f}", rate,
+                             min_rate)
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/// Ports of a "COM3,COM4" list, args made sure none is empty.
+std::vector<std::string_view> port_names(std::string_view list) {
+  std::vector<std::string_view> names;
+  for (auto comma = list.find(','); comma != std::string_view::npos;
+       comma = list.find(',')) {
+    names.push_back(list.substr(0, comma));
+    list.remove_prefix(comma + 1);
+  }
+  names.push_back(list);
+  return names;
+}
+
+/// Runs the --stream channel groups at their own rates on every port.
+int run_multi_rate(const excserial::Options &options) {
+  const std::int32_t n = options.value;
+  const bool virtual_run = options.virtual_seconds > 0.0;
+  const auto names = port_names(options.port);
+
+  excserial::MultiRateScheduler scheduler;
+  std::deque<excserial::SerialPort> serials;
+  std::deque<excserial::CapturePort> captures;
+  excserial::VirtualClock virtual_clock;
+  std::vector<std::size_t> ports;
+  if (virtual_run)
+    scheduler.use_clock(virtual_clock);
+  for (const auto name : names) {
+    if (virtual_run) {
+      ports.push_back(scheduler.add_port(captures.emplace_back()));
+      continue;
+    }
+    auto &serial = serials.emplace_back();
+    if (!serial.open(name, {.baud_rate = options.baud_rate})) {
+      std::cerr << serial.error() << std::endl;
+      return EXIT_FAILURE;
+    }
+    ports.push_back(scheduler.add_port(serial));
+  }
+  if (!virtual_run) {
+    std::cout << (names.size() == 1
+                      ? "Serial port successfully configured!"
+                      : "Serial ports successfully configured!")
+              << std::endl;
+  }
+  scheduler.set_pacing(options.pacing, options.spin);
+  scheduler.set_format(options.format);
+  scheduler.set_placement(options.placement);
+  if (options.writer_threads)
+    scheduler.use_writer_pool(*options.writer_threads);
+
+  // Listed streams, then the remaining channels at the base rate
+  std::vector<excserial::RateSpec> specs(
+      options.streams.begin(), options.streams.begin() + options.stream_count);
+  std::uint32_t used = 0;
+  for (const auto &spec : specs)
+    used |= spec.channels;
+  if (used != 0xF)
+    specs.push_back({0xF & ~used, options.rate_hz});
+
+  // All ports carry the same streams at the same baud rate
+  if (!virtual_run &&
+      !check_link(*excserial::plan_link(options, serials.front().settings())))
+    return EXIT_FAILURE;
+
+  // Streams of port p are p * specs.size() onwards
+  std::uint64_t tick_limit = 0;
+  for (const auto port : ports) {
+    for (const auto &spec : specs) {
+      scheduler.add_stream({
+          .port = port,
+          .period = excserial::Period::from_rate(spec.rate_hz),
+          .channels = spec.channels,
+          .values = {n, n, n, n},
+          .alternate = true,
+      });
+      if (virtual_run)
+        tick_limit += static_cast<std::uint64_t>(
+            std::llround(options.virtual_seconds * spec.rate_hz));
+    }
+  }
+  for (const auto &spec : specs) {
+    std::cout << std::format("Sending [+/-] {} on channels {} with {}Hz", n,
+                             channel_names(spec.channels), spec.rate_hz)
+              << std::endl;
+  }
+  if (names.size() > 1)
+    std::cout << std::format("to {} ports", names.size()) << std::endl;
+
+  const auto start_time = std::chrono::steady_clock::now();
+  if (!scheduler.start(tick_limit)) {
+    std::cerr << scheduler.error() << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (options.placement.requested())
+    print_placement(scheduler.placement(), names.front());
+
+  // One channel group over all ports: ticks and misses summed, the worst
+  // mean and maximum lateness
+  const auto group_lateness = [&scheduler, &specs,
+                               &ports](std::size_t group) {
+    excserial::StreamLateness total;
+    for (std::size_t port = 0; port < ports.size(); ++port) {
+      const auto lateness = scheduler.lateness(port * specs.size() + group);
+      total.ticks += lateness.ticks;
+      total.missed += lateness.missed;
+      total.mean_us = std::max(total.mean_us, lateness.mean_us);
+      total.max_us = std::max(total.max_us, lateness.max_us);
+    }
+    return total;
+  };
+
+  // Status print or dashboard until ctrl+c or a write error
+  std::vector<std::string> groups;
+  for (const auto &spec : specs)
+    groups.push_back(channel_names(spec.channels));
+  excserial::Dashboard dashboard;
+  excserial::StatusReporter reporter;
+  if (options.dashboard_hz > 0.0) {
+    for (std::size_t i = 0; i < ports.size(); ++i) {
+      dashboard.add_scheduled_port(std::string(names[i]), scheduler,
+                                   ports[i]);
+    }
+    dashboard.start(std::chrono::milliseconds(
+        std::llround(1e3 / options.dashboard_hz)));
+  } else {
+    reporter.start(
+        [&scheduler, &groups, &group_lateness,
+         &options](excserial::StatusLine &line) {
+          line.append("Writes: {}", scheduler.writes());
+          if (options.writer_threads)
+            line.append(", {} dropped", scheduler.dropped());
+          for (std::size_t i = 0; i < groups.size(); ++i) {
+            const auto lateness = group_lateness(i);
+            line.append(" | {}: {} ticks, {} missed, {:.0f}/{:.0f} us",
+                        groups[i], lateness.ticks, lateness.missed,
+                        lateness.mean_us, lateness.max_us);
+          }
+        },
+        2s);
+  }
+  while (!gStopRequested && scheduler.running())
+    std::this_thread::sleep_for(50ms);
+
+  dashboard.stop();
+  reporter.stop();
+  scheduler.stop();
+  if (!scheduler.error().empty()) {
+    std::cerr << std::endl << scheduler.error() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << std::endl;
+  for (std::size_t i = 0; i < specs.size(); ++i) {
+    const auto lateness = group_lateness(i);
+    std::cout << std::format("Channels {}: {} ticks, {} missed, lateness "
+                             "mean {:.1f} us, max {:.1f} us",
+                             groups[i], lateness.ticks, lateness.missed,
+                             lateness.mean_us, lateness.max_us)
+              << std::endl;
+  }
+  std::cout << "Writes after merging: " << scheduler.writes() << std::endl;
+  if (options.writer_threads) {
+    std::cout << "Frames dropped while a port was busy: "
+              << scheduler.dropped() << std::endl;
+  }
+
+  if (virtual_run) {
+    const std::chrono::duration<double> wall_time =
+        std::chrono::steady_clock::now() - start_time;
+    std::uint64_t bytes = 0;
+    for (const auto &capture : captures)
+      bytes += capture.bytes();
+    std::cout << std::format("Virtual run: {} bytes in {:.3f} s wall", bytes,
+                             wall_time.count())
+              << std::endl;
+    for (std::size_t i = 0; i < captures.size(); ++i) {
+      const auto hash = captures[i].hash();
+      if (captures.size() == 1)
+        std::cout << std::format("Stream hash: {:016x}", hash) << std::endl;
+      else
+        std::cout << std::format("Stream hash of {}: {:016x}", names[i], hash)
+                  << std::endl;
+      if (options.expected_hash && hash != *options.expected_hash) {
+        std::cerr << std::format("Stream hash mismatch, expected {:016x}",
+                                 *options.expected_hash)
+                  << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+    if (scheduler.heap_allocations() != 0) {
+      std::cerr << std::format("Scheduler thread made {} heap allocations "
+                               "while running",
+                               scheduler.heap_allocations())
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+    if (scheduler.arena().overflow() != 0) {
+      std::cerr << std::format("Arena too small by {} bytes",
+                               scheduler.arena().overflow())
                 << std::endl;
       return EXIT_FAILURE;
     }
+    if (!check_min_rate(scheduler.writes(), wall_time, options.min_rate))
+      return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+/// Sends addressed frames to the --device list sharing the port as a bus.
+int run_bus(const excserial::Options &options) {
+  const std::int32_t n = options.value;
+  const bool virtual_run = options.virtual_seconds > 0.0;
+  const auto &bus = options.bus;
+
+  excserial::SerialPort serial;
+  excserial::CapturePort capture;
+  excserial::VirtualClock virtual_clock;
+  excserial::BusScheduler scheduler;
+  excserial::Port *port = &capture;
+  const excserial::PortSettings settings{
+      .baud_rate = options.baud_rate,
+      .rts_toggle = bus.direction == excserial::DirectionControl::driver,
+  };
+  if (virtual_run) {
+    scheduler.use_clock(virtual_clock);
+  } else {
+    if (!serial.open(options.port, settings)) {
+      std::cerr << serial.error() << std::endl;
+      return EXIT_FAILURE;
+    }
+    port = &serial;
+    std::cout << "Serial port successfully configured!" << std::endl;
+  }
+  scheduler.set_pacing(options.pacing, options.spin);
+  scheduler.set_format(options.format);
+  scheduler.set_settings(bus);
+
+  std::uint64_t frame_limit = 0;
+  double total_rate = 0.0;
+  for (std::size_t i = 0; i < options.device_count; ++i) {
+    const auto &spec = options.devices[i];
+    const double rate_hz = spec.rate_hz > 0.0 ? spec.rate_hz : options.rate_hz;
+    scheduler.add_device({
+        .address = spec.address,
+        .period = excserial::Period::from_rate(rate_hz),
+        .values = {n, n, n, n},
+        .alternate = true,
+        .priority = spec.priority,
+    });
+    total_rate += rate_hz;
+    if (virtual_run)
+      frame_limit +=
+          static_cast<std::uint64_t>(std::llround(options.virtual_seconds *
+                                                  rate_hz));
+    std::cout << std::format("Sending [+/-] {} to device {} with {}Hz", n,
+                             spec.address, rate_hz)
+              << std::endl;
+  }
+
+  // At worst every frame is a transmission of its own
+  const double limit = excserial::line_limit(settings);
+  if (!virtual_run) {
+    const auto budget = *excserial::plan_link(options, settings);
+    if (!check_link(budget))
+      return EXIT_FAILURE;
+    const double turnaround_load =
+        total_rate * std::chrono::duration<double>(bus.turnaround).count();
+    if (budget.load() + turnaround_load > 1.0) {
+      std::cout << std::format("Warning: with turnaround the bus is {:.0f}% "
+                               "used unless frames share transmissions",
+                               (budget.load() + turnaround_load) * 100.0)
+                << std::endl;
+    }
+  }
+
+  const auto start_time = std::chrono::steady_clock::now();
+  if (!scheduler.start(*port, limit, frame_limit)) {
+    std::cerr << scheduler.error() << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << std::format("Bus {} with {} devices, {}, RTS {}, {:.0f} us "
+                           "turnaround...",
+                           virtual_run ? "capture" : options.port,
+                           options.device_count, to_string(bus.policy),
+                           to_string(bus.direction),
+                           std::chrono::duration<double, std::micro>(
+                               bus.turnaround)
+                               .count())
+            << std::endl;
+
+  // Status print until ctrl+c or a write error
+  excserial::StatusReporter reporter;
+  reporter.start(
+      [&scheduler](excserial::StatusLine &line) {
+        const auto stats = scheduler.stats();
+        const std::chrono::duration<double> elapsed = stats.elapsed;
+        line.append("Frames: {} in {} transmissions | {:.1f}% data",
+                    stats.frames, stats.transmissions,
+                    stats.utilization() * 100.0);
+        if (elapsed.count() > 0.0) {
+          line.append(", {:.1f}% turnaround",
+                      std::chrono::duration<double>(stats.turnaround) /
+                          elapsed * 100.0);
+        }
+      },
+      2s);
+  while (!gStopRequested && scheduler.running())
+    std::this_thread::sleep_for(50ms);
+
+  reporter.stop();
+  scheduler.stop();
+  if (!scheduler.error().empty()) {
+    std::cerr << std::endl << scheduler.error() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << std::endl;
+  for (std::size_t i = 0; i < options.device_count; ++i) {
+    const auto lateness = scheduler.lateness(i);
+    std::cout << std::format("Device {}: {} frames, {} missed, lateness "
+                             "mean {:.1f} us, max {:.1f} us",
+                             options.devices[i].address, lateness.ticks,
+                             lateness.missed, lateness.mean_us,
+                             lateness.max_us)
+              << std::endl;
   }
+  const auto stats = scheduler.stats();
+  const std::chrono::duration<double> elapsed = stats.elapsed;
+  std::cout << std::format("{} frames in {} transmissions, {} bytes, bus "
+                           "{:.1f}% data and {:.1f}% turnaround",
+                           stats.frames, stats.transmissions, stats.bytes,
+                           stats.utilization() * 100.0,
+                           elapsed.count() > 0.0
+                               ? std::chrono::duration<double>(
+                                     stats.turnaround) /
+                                     elapsed * 100.0
+                               : 0.0)
+            << std::endl;
 
-  int f; // Frequency to send
-  {
-    std::stringstream ss(argv[3]);
-    ss >> f;
-    if (!ss) {
-      std::cerr << std::format("Can't convert arg {} to number!",
-                               std::string_view(argv[2]))
+  if (virtual_run) {
+    const std::chrono::duration<double> wall_time =
+        std::chrono::steady_clock::now() - start_time;
+    std::cout << std::format("Virtual run: {} bytes in {:.3f} s wall",
+                             capture.bytes(), wall_time.count())
+              << std::endl;
+    std::cout << std::format("Stream hash: {:016x}", capture.hash())
+              << std::endl;
+    if (options.expected_hash && capture.hash() != *options.expected_hash) {
+      std::cerr << std::format("Stream hash mismatch, expected {:016x}",
+                               *options.expected_hash)
                 << std::endl;
       return EXIT_FAILURE;
     }
-    if (f > 1000) {
-      std::cerr << "Frequency cant be bigger than 1000" << std::endl;
+    if (!check_min_rate(stats.frames, wall_time, options.min_rate))
+      return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+/// Polls the --poll Modbus slaves and reports what became of the requests.
+int run_poll(const excserial::Options &options) {
+  const bool virtual_run = options.virtual_seconds > 0.0;
+  const excserial::PortSettings settings{
+      .baud_rate = options.baud_rate,
+      .rts_toggle =
+          options.bus.direction == excserial::DirectionControl::driver,
+  };
+
+  excserial::SerialPort serial;
+  excserial::VirtualClock virtual_clock;
+  excserial::ModbusSlavePort slaves(virtual_clock, settings);
+  excserial::ModbusPoller poller;
+  excserial::Port *port = &slaves;
+  if (virtual_run) {
+    poller.use_clock(virtual_clock);
+  } else {
+    if (!serial.open(options.port, settings)) {
+      std::cerr << serial.error() << std::endl;
       return EXIT_FAILURE;
     }
+    port = &serial;
+    std::cout << "Serial port successfully configured!" << std::endl;
   }
-  std::chrono::milliseconds sleep_time_ms{1000 / f};
+  poller.set_pacing(options.pacing, options.spin);
+  poller.set_settings({
+      .response_timeout = options.response_timeout,
+      .direction = options.bus.direction,
+  });
 
-  // Bind to the com port
-  std::string_view comport{argv[1]}; // Name of the com port
-  const CHAR *pcCommPort = TEXT(argv[1]);
-  HANDLE hCom = CreateFile(pcCommPort, GENERIC_READ | GENERIC_WRITE, 0, nullptr,
-                           OPEN_EXISTING, 0, nullptr);
+  std::uint64_t request_limit = 0;
+  double total_rate = 0.0;
+  for (std::size_t i = 0; i < options.poll_count; ++i) {
+    const auto &spec = options.polls[i];
+    const double rate_hz = spec.rate_hz > 0.0 ? spec.rate_hz : options.rate_hz;
+    poller.add_poll({
+        .slave = spec.slave,
+        .address = options.poll_address,
+        .count = options.poll_registers,
+        .period = excserial::Period::from_rate(rate_hz),
+    });
+    slaves.add_slave(spec.slave);
+    total_rate += rate_hz;
+    if (virtual_run)
+      request_limit +=
+          static_cast<std::uint64_t>(std::llround(options.virtual_seconds *
+                                                  rate_hz));
+    std::cout << std::format("Polling slave {} for {} registers from {} "
+                             "with {}Hz",
+                             spec.slave, options.poll_registers,
+                             options.poll_address, rate_hz)
+              << std::endl;
+  }
+
+  // One request at a time, so the bus caps the sum of the rates
+  const auto cycle =
+      excserial::modbus_read_cycle(settings, options.poll_registers);
+  const double max_rate = 1.0 / std::chrono::duration<double>(cycle).count();
+  std::cout << std::format("Bus: {:.0f} us per read at {} baud, up to {:.0f} "
+                           "polls/s, {:.0f}% used",
+                           std::chrono::duration<double, std::micro>(cycle)
+                               .count(),
+                           options.baud_rate, max_rate,
+                           total_rate / max_rate * 100.0)
+            << std::endl;
+  if (total_rate > max_rate) {
+    std::cout << "Warning: the bus can't carry every poll, late polls skip "
+                 "their missed periods"
+              << std::endl;
+  }
+
+  if (!poller.start(*port, settings, request_limit)) {
+    std::cerr << poller.error() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Status print until ctrl+c or a port error
+  excserial::StatusReporter reporter;
+  reporter.start(
+      [&poller, &options](excserial::StatusLine &line) {
+        for (std::size_t i = 0; i < options.poll_count; ++i) {
+          const auto stats = poller.stats(i);
+          line.append("{}slave {}: {}/{} ok, {:.0f} us",
+                      i == 0 ? "" : " | ", options.polls[i].slave,
+                      stats.responses, stats.requests,
+                      stats.latency_mean_us);
+        }
+      },
+      2s);
+  while (!gStopRequested && poller.running())
+    std::this_thread::sleep_for(50ms);
 
-  if (hCom == INVALID_HANDLE_VALUE) {
-    std::cerr << std::format("CreateFile failed with error: {}",
-                             error_string(GetLastError()))
+  reporter.stop();
+  poller.stop();
+  if (!poller.error().empty()) {
+    std::cerr << std::endl << poller.error() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << std::endl;
+  std::uint64_t requests = 0;
+  for (std::size_t i = 0; i < options.poll_count; ++i) {
+    const auto stats = poller.stats(i);
+    requests += stats.requests;
+    std::cout << std::format("Slave {}: {} requests, {} ok, {} timeouts, {} "
+                             "bad frames, {} exceptions, {} mismatched, {} "
+                             "missed, latency mean {:.1f} us, max {:.1f} us",
+                             options.polls[i].slave, stats.requests,
+                             stats.responses, stats.timeouts,
+                             stats.bad_frames, stats.exceptions,
+                             stats.mismatches, stats.missed,
+                             stats.latency_mean_us, stats.latency_max_us)
+              << std::endl;
+  }
+  const std::chrono::duration<double> elapsed = poller.elapsed();
+  if (elapsed.count() > 0.0) {
+    std::cout << std::format("{:.0f} polls/s, {:.0f}% of the bus limit, {} "
+                             "stray bytes",
+                             static_cast<double>(requests) / elapsed.count(),
+                             static_cast<double>(requests) /
+                                 elapsed.count() / max_rate * 100.0,
+                             poller.stray_bytes())
               << std::endl;
+  }
+  return EXIT_SUCCESS;
+}
+
+/// Sends the --burst pattern and compares the throughput to the line limit.
+int run_burst(const excserial::Options &options) {
+  excserial::SerialPort serial;
+  if (!serial.open(options.port, {.baud_rate = options.baud_rate})) {
+    std::cerr << serial.error() << std::endl;
     return EXIT_FAILURE;
   }
+  std::cout << "Serial port successfully configured!" << std::endl;
+
+  const auto &pattern = *options.burst;
+  const std::int32_t n = options.value;
+  excserial::BurstSender sender;
+  if (!sender.start(serial, pattern, {n, n, n, n}, true, options.pacing,
+                    options.format)) {
+    std::cerr << sender.error() << std::endl;
+    return EXIT_FAILURE;
+  }
+  const std::chrono::duration<double, std::milli> gap_ms = pattern.gap;
+  std::cout << std::format("Sending bursts of {} frames [+/-] {} to {}, "
+                           "{} ms apart...",
+                           pattern.frames, n, options.port, gap_ms.count())
+            << std::endl;
+
+  const double limit = excserial::line_limit(serial.settings());
+  excserial::StatusReporter reporter;
+  reporter.start(
+      [&sender, limit](excserial::StatusLine &line) {
+        const auto stats = sender.stats();
+        line.append("Bursts: {} | {:.0f} bytes/s, {:.1f}% of the line",
+                    stats.bursts, stats.throughput(),
+                    100.0 * stats.throughput() / limit);
+      },
+      2s);
+  while (!gStopRequested && sender.running())
+    std::this_thread::sleep_for(50ms);
+
+  reporter.stop();
+  sender.stop();
+  if (!sender.error().empty()) {
+    std::cerr << std::endl << sender.error() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const auto stats = sender.stats();
+  const std::chrono::duration<double> wire_time = stats.wire_time;
+  std::cout << std::endl
+            << std::format("Sent {} bursts, {} frames, {} bytes in {:.3f} s "
+                           "on the wire",
+                           stats.bursts, stats.frames, stats.bytes,
+                           wire_time.count())
+            << std::endl;
+  std::cout << std::format("Throughput {:.0f} bytes/s, {:.1f}% of the "
+                           "{:.0f} bytes/s {} baud allow",
+                           stats.throughput(),
+                           100.0 * stats.throughput() / limit, limit,
+                           options.baud_rate)
+            << std::endl;
+  return EXIT_SUCCESS;
+}
+
+/// Saturates the line until ctrl+c and reports the sustained throughput.
+int run_soak(const excserial::Options &options) {
+  excserial::SerialPort serial;
+  if (!serial.open(options.port, {.baud_rate = options.baud_rate})) {
+    std::cerr << serial.error() << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << "Serial port successfully configured!" << std::endl;
+
+  const std::int32_t n = options.value;
+  const double limit = excserial::line_limit(serial.settings());
+  excserial::SoakSender sender;
+  if (!sender.start(serial, limit, options.soak_fill, {n, n, n, n}, true,
+                    options.format)) {
+    std::cerr << sender.error() << std::endl;
+    return EXIT_FAILURE;
+  }
+  const std::chrono::duration<double, std::milli> fill_ms =
+      options.soak_fill;
+  std::cout << std::format("Saturating {} with [+/-] {}, {} ms queued, "
+                           "ctrl+c to stop...",
+                           options.port, n, fill_ms.count())
+            << std::endl;
+
+  excserial::StatusReporter reporter;
+  reporter.start(
+      [&sender, limit](excserial::StatusLine &line) {
+        const auto stats = sender.stats();
+        line.append("{:.0f} s | {:.0f} bytes/s, {:.1f}% of the line | "
+                    "queued {}",
+                    std::chrono::duration<double>(stats.elapsed).count(),
+                    stats.throughput(), 100.0 * stats.throughput() / limit,
+                    stats.queued_bytes);
+        if (stats.min_window_throughput > 0.0) {
+          line.append(" | worst {:.0f} s: {:.1f}%",
+                      std::chrono::duration<double>(
+                          excserial::SoakSender::window)
+                          .count(),
+                      100.0 * stats.min_window_throughput / limit);
+        }
+      },
+      2s);
+  while (!gStopRequested && sender.running())
+    std::this_thread::sleep_for(50ms);
+
+  reporter.stop();
+  sender.stop();
+  if (!sender.error().empty()) {
+    std::cerr << std::endl << sender.error() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const auto stats = sender.stats();
+  const std::chrono::duration<double, std::ratio<3600>> hours =
+      stats.elapsed;
+  std::cout << std::endl
+            << std::format("Sent {} frames, {} bytes in {:.2f} h",
+                           stats.frames, stats.bytes, hours.count())
+            << std::endl;
+  std::cout << std::format("Sustained {:.0f} bytes/s, {:.1f}% of the {:.0f} "
+                           "bytes/s {} baud allow, worst window {:.1f}%",
+                           stats.throughput(),
+                           100.0 * stats.throughput() / limit, limit,
+                           options.baud_rate,
+                           100.0 * stats.min_window_throughput / limit)
+            << std::endl;
+  return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+  const bool selftest = argc >= 2 && std::string_view(argv[1]) == "selftest";
+  if (argc < 4 && !selftest) {
+    std::cout << "Usage: excserial COM3 10 500 [Pulses with 10 pulses "
+                 "alternating +/- at 500 Hz]"
+              << std::endl;
+    std::cout << "       excserial COM3 0 250 --shm sim [Values from shared "
+                 "memory block \"sim\" at 250 Hz]"
+              << std::endl;
+    std::cout << "         [--range 1000] [Largest shared memory value, "
+                 "sets the link budget]"
+              << std::endl;
+    std::cout << "       excserial sim 10 500 --virtual 600 [600 s in virtual "
+                 "time against a simulated port]"
+              << std::endl;
+    std::cout << "         [--expect-hash 1c8e18a973087625] [--min-rate 1e6] "
+                 "[Fail on other output or lower frames/s]"
+              << std::endl;
+    std::cout << "         [--trace trace.json] [Stage timestamps of recent "
+                 "frames as Chrome trace]"
+              << std::endl;
+    std::cout << "         [--pacing spin|sleep|hybrid|timer|adaptive] [Wait "
+                 "strategy between frames]"
+              << std::endl;
+    std::cout << "         [--lateness-percentile 99] [On-time target of "
+                 "adaptive pacing]"
+              << std::endl;
+    std::cout << "         [--spin yield|pause|tpause] [Busy wait flavour, "
+                 "pause and tpause save power]"
+              << std::endl;
+    std::cout << "         [--stream 12@1000] [Channels 1 and 2 at their "
+                 "own rate, repeatable]"
+              << std::endl;
+    std::cout << "         [--writers 2] [Threads writing the ports of a "
+                 "COM3,COM4 list]"
+              << std::endl;
+    std::cout << "         [--dashboard 4] [Full screen per-port view "
+                 "refreshed 4 times a second]"
+              << std::endl;
+    std::cout << "         [--burst 50x10@100] [10 bursts of 50 frames "
+                 "at wire speed, 100 ms apart]"
+              << std::endl;
+    std::cout << "         [--soak 20] [Saturate the line, keeping 20 ms "
+                 "of bytes queued]"
+              << std::endl;
+    std::cout << "         [--device 3@100:1] [RS-485 device 3 at 100 Hz, "
+                 "priority 1, repeatable]"
+              << std::endl;
+    std::cout << "         [--bus-policy round-robin|priority] "
+                 "[--rts manual|driver|none] [--turnaround 100]"
+              << std::endl;
+    std::cout << "         [--poll 3@100] [Poll Modbus slave 3 at 100 Hz, "
+                 "repeatable]"
+              << std::endl;
+    std::cout << "         [--registers 100+8] [--response-timeout 50] "
+                 "[Registers to read, timeout in ms]"
+              << std::endl;
+    std::cout << "         [--baud 921600] [Line speed, default 115200]"
+              << std::endl;
+    std::cout << "         [--format text|binary|delta] [Frame format, "
+                 "binary frames are 18 bytes, delta frames send changes]"
+              << std::endl;
+    std::cout << "         [--align utc] [Send on a grid of whole UTC "
+                 "seconds]"
+              << std::endl;
+    std::cout << "         [--cpu 12 | --numa-node 1|port] [Send thread "
+                 "placement, port picks the port's node]"
+              << std::endl;
+    std::cout << "       excserial selftest [COM3] [--jitter-budget 100] "
+                 "[Measure what rates this PC can hold]"
+              << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  std::cout << "Starting excserial program..." << std::endl;
+
+  // Validate the input
+  excserial::Options options;
+  excserial::ArgError arg_error;
+  if (!excserial::parse_args({argv + 1, static_cast<std::size_t>(argc - 1)},
+                             options, arg_error)) {
+    if (arg_error.arg.empty())
+      std::cerr << arg_error.message << std::endl;
+    else
+      std::cerr << std::format("{}: {}", arg_error.message, arg_error.arg)
+                << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (options.selftest) {
+    const excserial::SelftestOptions selftest_options{
+        .port = options.port,
+        .jitter_budget = options.jitter_budget,
+    };
+    std::cout << "Running self test, this takes a few seconds..." << std::endl;
+    const auto report = excserial::run_selftest(selftest_options);
+    excserial::print_report(report, selftest_options, std::cout);
+    return report.error.empty() ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
 
-  // Validation done
   // Handle ctrl+c
   if (!SetConsoleCtrlHandler(CtrlHandler, TRUE)) {
     std::cerr << "Failed to set control handler: "
-              << error_string(GetLastError()) << std::endl;
+              << excserial::error_string(GetLastError()) << std::endl;
     return EXIT_FAILURE;
   }
 
-  // Initialize DCB structure for com port
-  DCB dcb;
-  SecureZeroMemory(&dcb, sizeof(DCB));
-  dcb.DCBlength = sizeof(DCB);
+  if (options.stream_count > 0)
+    return run_multi_rate(options);
+  if (options.device_count > 0)
+    return run_bus(options);
+  if (options.poll_count > 0)
+    return run_poll(options);
+  if (options.burst)
+    return run_burst(options);
+  if (options.soak_fill.count() > 0)
+    return run_soak(options);
 
-  // Get current settings
-  if (!GetCommState(hCom, &dcb)) {
-    std::cerr << std::format("GetCommState filed with error {}",
-                             error_string(GetLastError()))
-              << std::endl;
+  const std::int32_t n = options.value; // Number to sent each iteration
+  const double f = options.rate_hz;     // Frequency to send
+  const std::string_view shm_name = options.shm_name;
+  const double virtual_seconds = options.virtual_seconds;
+
+  // Bind to the com port
+  const std::string_view comport = options.port;
+  const excserial::PortSettings settings{.baud_rate = options.baud_rate};
+  excserial::Stream stream;
+  excserial::CapturePort capture;
+  excserial::VirtualClock virtual_clock;
+  if (virtual_seconds > 0.0) {
+    stream.use_port(capture);
+    stream.use_clock(virtual_clock);
+  } else if (!stream.open_port(comport, settings)) {
+    std::cerr << stream.error() << std::endl;
+    return EXIT_FAILURE;
   }
 
-  // Set settings
-  dcb.BaudRate = CBR_115200;
-  dcb.ByteSize = 8;
-  dcb.Parity = NOPARITY;
-  dcb.StopBits = ONESTOPBIT;
-  std::cout << "Serial port successfully configured!" << std::endl;
+  if (virtual_seconds == 0.0)
+    std::cout << "Serial port successfully configured!" << std::endl;
 
-  // Without this timeout is infinite
-  COMMTIMEOUTS timeouts = {0};
-  timeouts.ReadIntervalTimeout = 50;
-  timeouts.ReadTotalTimeoutConstant = 10;
-  timeouts.ReadTotalTimeoutMultiplier = 10;
-  timeouts.WriteTotalTimeoutConstant = 50;
-  timeouts.WriteTotalTimeoutMultiplier = 10;
-  if (!SetCommTimeouts(hCom, &timeouts)) {
-    CloseHandle(hCom);
-    std::cerr << "Could not set timeouts with error: "
-              << error_string(GetLastError()) << std::endl;
-    return EXIT_FAILURE;
-  }
-
-  // Setup send loop
-  constexpr auto status_print_time = 2s;
-  unsigned int messages_sent = 0;
-  auto last_send_time = std::chrono::steady_clock::now();
-  auto last_print_time = last_send_time;
-
-  std::cout << "Sending [+/-] " << n << " to " << comport << " with " << f
-            << "Hz (" << sleep_time_ms.count() << " ms)..." << std::endl;
-
-  // Start the loop
-  while (!gStopRequested) {
-    // Busy wait loop since windows can't do sub 16 ms sleep with chrono
-    while (std::chrono::steady_clock::now() - last_send_time < sleep_time_ms) {
-      Sleep(0); // Yield CPU
-    }
-    const auto now = std::chrono::steady_clock::now();
-    last_send_time = now;
-
-    // Try to send
-    std::string msg = std::format("#{},{},{},{};", n, n, n, n);
-    DWORD bytesWritten = 0;
-    if (!WriteFile(hCom, msg.c_str(), static_cast<DWORD>(msg.size()),
-                   &bytesWritten, nullptr)) {
-      std::cerr << "Failed to write to " << comport
-                << " with error: " << error_string(GetLastError()) << std::endl;
-      CloseHandle(hCom);
-      return EXIT_FAILURE;
-    } else {
-      n *= -1; // Flip n to alternate
-      messages_sent++;
+  // Start the send thread
+  excserial::StreamConfig config{
+      .rate_hz = f,
+      .values = {n, n, n, n},
+      .alternate = shm_name.empty(),
+      .shm_name = std::string(shm_name),
+      .shm_range = options.shm_range,
+      .format = options.format,
+      .pacing = options.pacing,
+      .spin = options.spin,
+      .lateness_percentile = options.lateness_percentile,
+      .placement = options.placement,
+      .align_to_wall_clock = options.align_to_wall_clock,
+  };
+  if (!options.trace_path.empty())
+    config.trace_capacity = 1 << 16;
+  if (virtual_seconds > 0.0)
+    config.frame_count =
+        static_cast<std::uint64_t>(std::llround(virtual_seconds * f));
+  if (virtual_seconds == 0.0 &&
+      !check_link(*excserial::plan_link(options, settings)))
+    return EXIT_FAILURE;
+  const auto start_time = std::chrono::steady_clock::now();
+  if (!stream.start(config)) {
+    std::cerr << stream.error() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (options.placement.requested())
+    print_placement(stream.placement(), comport);
+
+  const std::chrono::duration<double, std::milli> period_ms =
+      stream.period().rounded();
+  if (!shm_name.empty()) {
+    std::cout << "Sending values from shared memory " << shm_name << " to "
+              << comport << " with " << f << "Hz (" << period_ms.count()
+              << " ms)..." << std::endl;
+  } else {
+    std::cout << "Sending [+/-] " << n << " to " << comport << " with " << f
+              << "Hz (" << period_ms.count() << " ms)..." << std::endl;
+  }
+
+  // Status print until ctrl+c or a write error
+  excserial::Dashboard dashboard;
+  excserial::StatusReporter reporter;
+  if (options.dashboard_hz > 0.0) {
+    dashboard.add_stream(std::string(comport), stream);
+    dashboard.start(std::chrono::milliseconds(
+        std::llround(1e3 / options.dashboard_hz)));
+  } else {
+    reporter.start(
+        [&stream, &options](excserial::StatusLine &line) {
+          const auto stats = stream.stats();
+          line.append("Messages sent: {}", stats.frames_sent);
+          if (options.align_to_wall_clock) {
+            line.append(" | UTC phase {:+.1f} us",
+                        std::chrono::duration<double, std::micro>(
+                            stream.alignment_error())
+                            .count());
+          }
+          if (stats.latency_count > 0) {
+            line.append(" | shm latency us min/avg/max: {:.1f}/{:.1f}/{:.1f}",
+                        stats.latency_min_us, stats.latency_avg_us,
+                        stats.latency_max_us);
+          }
+        },
+        2s);
+  }
+  while (!gStopRequested && stream.running())
+    std::this_thread::sleep_for(50ms);
+
+  dashboard.stop();
+  reporter.stop();
+  stream.stop();
+
+  if (!options.trace_path.empty()) {
+    std::ofstream trace_file{std::string(options.trace_path)};
+    stream.trace().write_chrome_trace(trace_file);
+    if (!trace_file) {
+      std::cerr << std::endl
+                << std::format("Could not write trace to {}",
+                               options.trace_path)
+                << std::endl;
     }
+  }
+
+  if (!stream.error().empty()) {
+    std::cerr << std::endl << stream.error() << std::endl;
+    return EXIT_FAILURE;
+  }
 
-    // Status print
-    if (now - last_print_time > status_print_time) {
-      std::cout << '\r' << std::string(120, ' ');
-      std::cout << "\rMessages sent: " << messages_sent << std::flush;
-      last_print_time = now;
+  if (virtual_seconds > 0.0) {
+    const std::chrono::duration<double> wall_time =
+        std::chrono::steady_clock::now() - start_time;
+    const auto frames = stream.stats().frames_sent;
+    std::cout << std::endl
+              << std::format("Virtual run: {} frames, {} bytes, {:.3f} s "
+                             "virtual in {:.3f} s wall ({:.0f} frames/s)",
+                             frames, capture.bytes(), virtual_seconds,
+                             wall_time.count(),
+                             frames / wall_time.count())
+              << std::endl;
+    std::cout << std::format("Stream hash: {:016x}", capture.hash())
+              << std::endl;
+
+    // Regression checks
+    if (options.expected_hash && capture.hash() != *options.expected_hash) {
+      std::cerr << std::format("Stream hash mismatch, expected {:016x}",
+                               *options.expected_hash)
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+    const auto allocations = stream.stats().heap_allocations;
+    if (allocations != 0) {
+      std::cerr << std::format("Send thread made {} heap allocations while "
+                               "running",
+                               allocations)
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+    if (stream.stats().arena_overflow != 0) {
+      std::cerr << std::format("Arena too small by {} bytes",
+                               stream.stats().arena_overflow)
+                << std::endl;
+      return EXIT_FAILURE;
     }
+    if (!check_min_rate(frames, wall_time, options.min_rate))
+      return EXIT_FAILURE;
+    return EXIT_SUCCESS;
   }
 
   std::cout << std::endl << "Got ctrl+c, exiting..." << std::endl;
 
-  CloseHandle(hCom);
-
   return EXIT_SUCCESS;
 }
@@ -0,0 +1,173 @@
+/**
+ * @file excserial_py.cpp
+ * @brief Python bindings for the native streaming engine.
+ *
+ * Python only sets up the stream, all pacing and I/O runs on the native send
+ * thread with the GIL released:
+ *
+ *   import numpy as np, excserial
+ *   t = np.arange(5000) / 1000.0
+ *   table = np.stack([1000 * np.sin(2 * np.pi * t)] * 4, axis=1)
+ *   table = np.ascontiguousarray(table, dtype=np.int32)
+ *   s = excserial.Stream()
+ *   s.open_port("COM3", baud_rate=460800)
+ *   s.start(rate_hz=1000, trajectory=table)
+ *   s.wait()
+ *
+ * Trajectories are played straight from the NumPy buffer without copying.
+ * The sine's 25 byte text frames need 460800 baud at 1000 Hz, start() throws
+ * if the line can't carry the rate.
+ */
+
+#include "excserial/stream.h"
+
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include <chrono>
+#include <optional>
+#include <thread>
+
+namespace py = pybind11;
+
+namespace {
+
+/// Keeps the Python object behind a trajectory alive while it is played.
+class PyStream {
+public:
+  void open_port(const std::string &name, DWORD baud_rate) {
+    excserial::PortSettings settings;
+    settings.baud_rate = baud_rate;
+    if (!stream_.open_port(name, settings))
+      throw std::runtime_error(stream_.error());
+  }
+
+  void start(double rate_hz, const excserial::Values &values, bool alternate,
+             const std::string &shm_name, std::int32_t shm_range,
+             std::optional<py::buffer> trajectory, bool loop) {
+    stop();
+
+    excserial::StreamConfig config{
+        .rate_hz = rate_hz,
+        .values = values,
+        .alternate = alternate,
+        .shm_name = shm_name,
+        .shm_range = shm_range,
+        .loop = loop,
+    };
+    if (trajectory) {
+      const auto info = trajectory->request();
+      if (info.format != py::format_descriptor<std::int32_t>::format())
+        throw py::type_error("Trajectory must have dtype int32");
+      if (info.ndim != 1 &&
+          !(info.ndim == 2 &&
+            info.shape[1] == static_cast<py::ssize_t>(
+                                 excserial::channel_count)))
+        throw py::value_error("Trajectory must have shape (N, 4) or (N * 4,)");
+      // Zero copy needs a C-contiguous buffer
+      py::ssize_t expected_stride = info.itemsize;
+      for (py::ssize_t dim = info.ndim - 1; dim >= 0; --dim) {
+        if (info.strides[dim] != expected_stride)
+          throw py::value_error("Trajectory must be C-contiguous, use "
+                                "numpy.ascontiguousarray");
+        expected_stride *= info.shape[dim];
+      }
+      config.trajectory = {static_cast<const std::int32_t *>(info.ptr),
+                           static_cast<std::size_t>(info.size)};
+      trajectory_owner_ = *trajectory;
+    }
+
+    if (!stream_.start(config)) {
+      trajectory_owner_ = py::none();
+      throw std::runtime_error(stream_.error());
+    }
+  }
+
+  void update_values(const excserial::Values &values) {
+    stream_.update_values(values);
+  }
+
+  /// Waits for the stream to end, returns false on timeout.
+  bool wait(std::optional<double> timeout_s) {
+    const auto deadline =
+        std::chrono::steady_clock::now() +
+        std::chrono::duration<double>(timeout_s.value_or(0.0));
+    while (stream_.running()) {
+      if (timeout_s && std::chrono::steady_clock::now() >= deadline)
+        return false;
+      {
+        py::gil_scoped_release release;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      }
+      // Let ctrl+c raise KeyboardInterrupt in the script
+      if (PyErr_CheckSignals() != 0)
+        throw py::error_already_set();
+    }
+    return true;
+  }
+
+  void stop() {
+    {
+      py::gil_scoped_release release;
+      stream_.stop();
+    }
+    trajectory_owner_ = py::none();
+  }
+
+  bool running() const {
+    return stream_.running();
+  }
+
+  py::dict stats() {
+    const auto stats = stream_.stats();
+    py::dict result;
+    result["frames_sent"] = stats.frames_sent;
+    result["bytes_sent"] = stats.bytes_sent;
+    result["latency_count"] = stats.latency_count;
+    result["latency_min_us"] = stats.latency_min_us;
+    result["latency_avg_us"] = stats.latency_avg_us;
+    result["latency_max_us"] = stats.latency_max_us;
+    result["heap_allocations"] = stats.heap_allocations;
+    result["arena_overflow"] = stats.arena_overflow;
+    return result;
+  }
+
+  std::string error() const {
+    return running() ? std::string{} : stream_.error();
+  }
+
+  double period_s() const {
+    return std::chrono::duration<double>(stream_.period().rounded()).count();
+  }
+
+private:
+  excserial::Stream stream_;
+  py::object trajectory_owner_ = py::none();
+};
+
+} // namespace
+
+PYBIND11_MODULE(excserial, m) {
+  m.doc() = "High-rate serial frame streaming";
+
+  py::class_<PyStream>(m, "Stream")
+      .def(py::init<>())
+      .def("open_port", &PyStream::open_port, py::arg("name"),
+           py::arg("baud_rate") = CBR_115200)
+      .def("start", &PyStream::start, py::arg("rate_hz"),
+           py::arg("values") = excserial::Values{},
+           py::arg("alternate") = false,
+           py::arg("shm_name") = "", py::arg("shm_range") = 0,
+           py::arg("trajectory") = py::none(),
+           py::arg("loop") = false,
+           "Starts sending. A trajectory is an int32 array of shape (N, 4) "
+           "played one row per tick.")
+      .def("update_values", &PyStream::update_values, py::arg("values"))
+      .def("wait", &PyStream::wait, py::arg("timeout") = py::none(),
+           "Waits for the stream to end, returns False on timeout.")
+      .def("stop", &PyStream::stop)
+      .def("stats", &PyStream::stats)
+      .def_property_readonly("running", &PyStream::running)
+      .def_property_readonly("error", &PyStream::error)
+      .def_property_readonly("period", &PyStream::period_s);
+}
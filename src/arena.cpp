@@ -0,0 +1,61 @@
+/**
+ * @file arena.cpp
+ * @brief Pre-sized memory for everything a port needs while running.
+ */
+
+#include "excserial/arena.h"
+
+#include "excserial/placement.h"
+
+#include <new>
+
+namespace excserial {
+
+namespace {
+
+thread_local std::uint64_t heap_allocations = 0;
+
+} // namespace
+
+Arena::Arena() {
+  monotonic_.emplace(&upstream_);
+}
+
+Arena::~Arena() {
+  monotonic_.reset();
+  free_on_node(block_);
+}
+
+void Arena::reset(std::size_t capacity, int numa_node) {
+  monotonic_.reset();
+  free_on_node(block_);
+  block_ = capacity > 0 ? allocate_on_node(capacity, numa_node) : nullptr;
+  capacity_ = block_ != nullptr ? capacity : 0;
+  upstream_.bytes = 0;
+  // A monotonic resource can't be pointed at another block, so rebuild it
+  if (block_ != nullptr)
+    monotonic_.emplace(block_, capacity_, &upstream_);
+  else
+    monotonic_.emplace(&upstream_);
+}
+
+void *Arena::CountingResource::do_allocate(std::size_t size,
+                                           std::size_t alignment) {
+  bytes += size;
+  return ::operator new(size, std::align_val_t{alignment});
+}
+
+void Arena::CountingResource::do_deallocate(void *memory, std::size_t size,
+                                            std::size_t alignment) {
+  ::operator delete(memory, size, std::align_val_t{alignment});
+}
+
+void count_heap_allocation() {
+  ++heap_allocations;
+}
+
+std::uint64_t thread_heap_allocations() {
+  return heap_allocations;
+}
+
+} // namespace excserial
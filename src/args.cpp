@@ -0,0 +1,598 @@
+/**
+ * @file args.cpp
+ * @brief Command line parsing for the excserial executable.
+ */
+
+#include "excserial/args.h"
+
+#include <charconv>
+#include <cmath>
+
+namespace excserial {
+
+namespace {
+
+template <typename T, typename... Base>
+bool parse_whole(std::string_view text, T &value, Base... base) {
+  T parsed{};
+  const char *const end = text.data() + text.size();
+  const auto [ptr, ec] = std::from_chars(text.data(), end, parsed, base...);
+  if (text.empty() || ec != std::errc{} || ptr != end)
+    return false;
+  value = parsed;
+  return true;
+}
+
+/// value units of ns_per_unit in whole nanoseconds. False if that doesn't
+/// fit, converting a huge double to an integer is undefined.
+bool to_nanoseconds(double value, double ns_per_unit,
+                    std::chrono::nanoseconds &duration) {
+  const double ns = std::round(value * ns_per_unit);
+  // 2^63, the first double past the range of nanoseconds
+  if (!(std::abs(ns) < 9223372036854775808.0))
+    return false;
+  duration = std::chrono::nanoseconds{static_cast<std::int64_t>(ns)};
+  return true;
+}
+
+} // namespace
+
+bool parse_number(std::string_view text, std::int32_t &value) {
+  return parse_whole(text, value);
+}
+
+bool parse_number(std::string_view text, std::uint32_t &value) {
+  return parse_whole(text, value);
+}
+
+bool parse_number(std::string_view text, double &value) {
+  double parsed = 0.0;
+  if (!parse_whole(text, parsed) || !std::isfinite(parsed))
+    return false;
+  value = parsed;
+  return true;
+}
+
+bool parse_hex(std::string_view text, std::uint64_t &value) {
+  return parse_whole(text, value, 16);
+}
+
+bool parse_rate_spec(std::string_view text, RateSpec &spec) {
+  const auto at = text.find('@');
+  if (at == 0 || at == std::string_view::npos)
+    return false;
+
+  RateSpec parsed;
+  for (const char c : text.substr(0, at)) {
+    if (c < '1' || c > '4')
+      return false;
+    parsed.channels |= 1u << (c - '1');
+  }
+  if (!parse_number(text.substr(at + 1), parsed.rate_hz) ||
+      parsed.rate_hz <= 0.0 || parsed.rate_hz > max_rate_hz)
+    return false;
+  spec = parsed;
+  return true;
+}
+
+bool parse_device_spec(std::string_view text, DeviceSpec &spec) {
+  DeviceSpec parsed;
+  const auto colon = text.find(':');
+  if (colon != std::string_view::npos) {
+    if (!parse_number(text.substr(colon + 1), parsed.priority))
+      return false;
+    text = text.substr(0, colon);
+  }
+  const auto at = text.find('@');
+  if (at != std::string_view::npos) {
+    if (!parse_number(text.substr(at + 1), parsed.rate_hz) ||
+        parsed.rate_hz <= 0.0 || parsed.rate_hz > max_rate_hz)
+      return false;
+    text = text.substr(0, at);
+  }
+  std::uint32_t address = 0;
+  if (!parse_number(text, address) || address > 255)
+    return false;
+  parsed.address = static_cast<std::uint8_t>(address);
+  spec = parsed;
+  return true;
+}
+
+bool parse_poll_spec(std::string_view text, PollSpec &spec) {
+  PollSpec parsed;
+  const auto at = text.find('@');
+  if (at != std::string_view::npos) {
+    if (!parse_number(text.substr(at + 1), parsed.rate_hz) ||
+        parsed.rate_hz <= 0.0 || parsed.rate_hz > max_rate_hz)
+      return false;
+    text = text.substr(0, at);
+  }
+  std::uint32_t slave = 0;
+  if (!parse_number(text, slave) || slave < 1 || slave > 247)
+    return false;
+  parsed.slave = static_cast<std::uint8_t>(slave);
+  spec = parsed;
+  return true;
+}
+
+bool parse_register_range(std::string_view text, std::uint16_t &address,
+                          std::uint16_t &count) {
+  std::uint32_t first = 0;
+  const auto plus = text.find('+');
+  if (plus != std::string_view::npos) {
+    if (!parse_number(text.substr(0, plus), first) || first > 0xFFFF)
+      return false;
+    text = text.substr(plus + 1);
+  }
+  std::uint32_t registers = 0;
+  if (!parse_number(text, registers) || registers == 0 ||
+      registers > modbus_max_registers || first + registers > 0x10000)
+    return false;
+  address = static_cast<std::uint16_t>(first);
+  count = static_cast<std::uint16_t>(registers);
+  return true;
+}
+
+bool parse_burst_spec(std::string_view text, BurstPattern &pattern) {
+  const auto times = text.find('x');
+  const auto at = text.find('@');
+  if (times == std::string_view::npos || at == std::string_view::npos ||
+      at < times)
+    return false;
+
+  BurstPattern parsed;
+  double gap_ms = 0.0;
+  if (!parse_number(text.substr(0, times), parsed.frames) ||
+      parsed.frames == 0 || parsed.frames > max_burst_frames ||
+      !parse_number(text.substr(times + 1, at - times - 1),
+                    parsed.repetitions) ||
+      !parse_number(text.substr(at + 1), gap_ms) || gap_ms < 0.0 ||
+      !to_nanoseconds(gap_ms, 1e6, parsed.gap))
+    return false;
+  pattern = parsed;
+  return true;
+}
+
+namespace {
+
+bool parse_selftest_args(std::span<const char *const> args, Options &options,
+                         ArgError &error) {
+  options.selftest = true;
+  std::size_t i = 1;
+  if (i < args.size() && !std::string_view(args[i]).starts_with("--"))
+    options.port = args[i++];
+
+  for (; i < args.size(); ++i) {
+    const std::string_view arg{args[i]};
+    if (arg == "--jitter-budget" && i + 1 < args.size()) {
+      const std::string_view value{args[++i]};
+      double budget_us = 0.0;
+      if (!parse_number(value, budget_us) || budget_us <= 0.0) {
+        error = {"Can't convert arg to a jitter budget", value};
+        return false;
+      }
+      if (!to_nanoseconds(budget_us, 1e3, options.jitter_budget)) {
+        error = {"Jitter budget out of range", value};
+        return false;
+      }
+    } else {
+      error = {"Unknown argument", arg};
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+bool parse_args(std::span<const char *const> args, Options &options,
+                ArgError &error) {
+  if (!args.empty() && std::string_view(args[0]) == "selftest")
+    return parse_selftest_args(args, options, error);
+
+  if (args.size() < 3) {
+    error = {"Expected port, value and rate", {}};
+    return false;
+  }
+
+  options.port = args[0];
+  if (!parse_number(args[1], options.value)) {
+    error = {"Can't convert arg to number", args[1]};
+    return false;
+  }
+  if (!parse_number(args[2], options.rate_hz)) {
+    error = {"Can't convert arg to number", args[2]};
+    return false;
+  }
+
+  bool bus_options = false;
+  bool rts_option = false;
+  bool poll_options = false;
+  for (std::size_t i = 3; i < args.size(); ++i) {
+    const std::string_view arg{args[i]};
+    if (i + 1 == args.size()) {
+      error = {"Unknown argument or missing value", arg};
+      return false;
+    }
+    const std::string_view value{args[++i]};
+
+    if (arg == "--shm") {
+      options.shm_name = value;
+    } else if (arg == "--range") {
+      if (!parse_number(value, options.shm_range) || options.shm_range <= 0) {
+        error = {"Expected a positive value range", value};
+        return false;
+      }
+    } else if (arg == "--virtual") {
+      if (!parse_number(value, options.virtual_seconds) ||
+          options.virtual_seconds <= 0.0) {
+        error = {"Can't convert arg to a duration", value};
+        return false;
+      }
+      // The virtual clock counts nanoseconds
+      std::chrono::nanoseconds duration;
+      if (!to_nanoseconds(options.virtual_seconds, 1e9, duration)) {
+        error = {"Virtual duration out of range", value};
+        return false;
+      }
+    } else if (arg == "--expect-hash") {
+      std::uint64_t hash = 0;
+      if (!parse_hex(value, hash)) {
+        error = {"Can't convert arg to a hash", value};
+        return false;
+      }
+      options.expected_hash = hash;
+    } else if (arg == "--min-rate") {
+      if (!parse_number(value, options.min_rate)) {
+        error = {"Can't convert arg to number", value};
+        return false;
+      }
+    } else if (arg == "--trace") {
+      options.trace_path = value;
+    } else if (arg == "--pacing") {
+      const auto mode = parse_pacing_mode(value);
+      if (!mode) {
+        error = {"Unknown pacing mode", value};
+        return false;
+      }
+      options.pacing = *mode;
+    } else if (arg == "--format") {
+      const auto format = parse_frame_format(value);
+      if (!format) {
+        error = {"Unknown frame format", value};
+        return false;
+      }
+      options.format = *format;
+    } else if (arg == "--spin") {
+      const auto mode = parse_spin_mode(value);
+      if (!mode) {
+        error = {"Unknown spin mode", value};
+        return false;
+      }
+      options.spin = *mode;
+    } else if (arg == "--stream") {
+      RateSpec spec;
+      if (!parse_rate_spec(value, spec)) {
+        error = {"Expected channels@rate like 12@1000", value};
+        return false;
+      }
+      std::uint32_t used = 0;
+      for (std::size_t s = 0; s < options.stream_count; ++s)
+        used |= options.streams[s].channels;
+      if (spec.channels & used) {
+        error = {"Channel is already in another stream", value};
+        return false;
+      }
+      options.streams[options.stream_count++] = spec;
+    } else if (arg == "--writers") {
+      std::uint32_t threads = 0;
+      if (!parse_number(value, threads) || threads > max_writer_threads) {
+        error = {"Writer threads must be in [0, 64]", value};
+        return false;
+      }
+      options.writer_threads = threads;
+    } else if (arg == "--device") {
+      DeviceSpec spec;
+      if (!parse_device_spec(value, spec)) {
+        error = {"Expected address[@rate][:priority] like 3@100:1", value};
+        return false;
+      }
+      if (options.device_count == max_bus_devices) {
+        error = {"Too many devices on one bus", value};
+        return false;
+      }
+      for (std::size_t d = 0; d < options.device_count; ++d) {
+        if (options.devices[d].address == spec.address) {
+          error = {"Device address is already in use", value};
+          return false;
+        }
+      }
+      options.devices[options.device_count++] = spec;
+    } else if (arg == "--bus-policy") {
+      const auto policy = parse_bus_policy(value);
+      if (!policy) {
+        error = {"Unknown bus policy", value};
+        return false;
+      }
+      options.bus.policy = *policy;
+      bus_options = true;
+    } else if (arg == "--rts") {
+      const auto control = parse_direction_control(value);
+      if (!control) {
+        error = {"Unknown RTS direction control", value};
+        return false;
+      }
+      options.bus.direction = *control;
+      rts_option = true;
+    } else if (arg == "--turnaround") {
+      double turnaround_us = 0.0;
+      if (!parse_number(value, turnaround_us) || turnaround_us < 0.0 ||
+          turnaround_us > 100'000.0 ||
+          !to_nanoseconds(turnaround_us, 1e3, options.bus.turnaround)) {
+        error = {"Turnaround must be in [0, 100000] us", value};
+        return false;
+      }
+      bus_options = true;
+    } else if (arg == "--poll") {
+      PollSpec spec;
+      if (!parse_poll_spec(value, spec)) {
+        error = {"Expected slave[@rate] like 3@100, slaves are 1 to 247",
+                 value};
+        return false;
+      }
+      if (options.poll_count == max_polls) {
+        error = {"Too many polls", value};
+        return false;
+      }
+      options.polls[options.poll_count++] = spec;
+    } else if (arg == "--registers") {
+      if (!parse_register_range(value, options.poll_address,
+                                options.poll_registers)) {
+        error = {"Expected [address+]count like 100+8, at most 125", value};
+        return false;
+      }
+      poll_options = true;
+    } else if (arg == "--response-timeout") {
+      double timeout_ms = 0.0;
+      if (!parse_number(value, timeout_ms) || timeout_ms <= 0.0 ||
+          timeout_ms > 10'000.0 ||
+          !to_nanoseconds(timeout_ms, 1e6, options.response_timeout)) {
+        error = {"Response timeout must be in (0, 10000] ms", value};
+        return false;
+      }
+      poll_options = true;
+    } else if (arg == "--lateness-percentile") {
+      double percent = 0.0;
+      if (!parse_number(value, percent) || percent < 50.0 ||
+          percent >= 100.0) {
+        error = {"Lateness percentile must be in [50, 100)", value};
+        return false;
+      }
+      options.lateness_percentile = percent / 100.0;
+    } else if (arg == "--dashboard") {
+      if (!parse_number(value, options.dashboard_hz) ||
+          options.dashboard_hz <= 0.0 || options.dashboard_hz > 50.0) {
+        error = {"Dashboard refresh must be in (0, 50] Hz", value};
+        return false;
+      }
+    } else if (arg == "--burst") {
+      BurstPattern pattern;
+      if (!parse_burst_spec(value, pattern)) {
+        error = {"Expected frames x bursts @ gap ms like 50x10@100, or gap "
+                 "out of range",
+                 value};
+        return false;
+      }
+      options.burst = pattern;
+    } else if (arg == "--soak") {
+      double fill_ms = 0.0;
+      if (!parse_number(value, fill_ms) || fill_ms <= 0.0 ||
+          fill_ms > 1000.0 ||
+          !to_nanoseconds(fill_ms, 1e6, options.soak_fill)) {
+        error = {"Soak fill level must be in (0, 1000] ms", value};
+        return false;
+      }
+    } else if (arg == "--baud") {
+      if (!parse_number(value, options.baud_rate) || options.baud_rate == 0) {
+        error = {"Can't convert arg to a baud rate", value};
+        return false;
+      }
+    } else if (arg == "--align") {
+      if (value != "utc") {
+        error = {"Only --align utc is supported", value};
+        return false;
+      }
+      options.align_to_wall_clock = true;
+    } else if (arg == "--cpu") {
+      std::int32_t cpu = 0;
+      if (!parse_number(value, cpu) || cpu < 0) {
+        error = {"Can't convert arg to a processor number", value};
+        return false;
+      }
+      options.placement.cpu = cpu;
+    } else if (arg == "--numa-node") {
+      std::int32_t node = 0;
+      if (value == "port") {
+        options.placement.near_port = true;
+      } else if (parse_number(value, node) && node >= 0) {
+        options.placement.numa_node = node;
+      } else {
+        error = {"Expected a NUMA node number or port", value};
+        return false;
+      }
+    } else {
+      error = {"Unknown argument", arg};
+      return false;
+    }
+  }
+
+  if (options.port.find(',') != std::string_view::npos) {
+    if (options.stream_count == 0) {
+      error = {"Several ports need --stream", options.port};
+      return false;
+    }
+    if (options.port.starts_with(',') || options.port.ends_with(',') ||
+        options.port.find(",,") != std::string_view::npos) {
+      error = {"Empty port name", options.port};
+      return false;
+    }
+  }
+  // Bursts and soak runs go out at wire speed, the rate is unused
+  if (!options.burst && options.soak_fill.count() == 0) {
+    if (options.rate_hz <= 0.0) {
+      error = {"Frequency must be positive", args[2]};
+      return false;
+    }
+    if (options.rate_hz > max_rate_hz) {
+      error = {"Frequency cant be bigger than 1000", args[2]};
+      return false;
+    }
+  }
+  if (options.writer_threads) {
+    if (options.stream_count == 0) {
+      error = {"--writers needs --stream", {}};
+      return false;
+    }
+    // The pool keeps only the newest frame of a busy port
+    if (options.format == FrameFormat::delta || options.expected_hash) {
+      error = {"--writers can't be combined with --format delta or "
+               "--expect-hash, it drops frames",
+               {}};
+      return false;
+    }
+  }
+  if (options.burst && options.soak_fill.count() > 0) {
+    error = {"--burst can't be combined with --soak", {}};
+    return false;
+  }
+  if ((options.burst || options.soak_fill.count() > 0) &&
+      (options.stream_count > 0 || options.device_count > 0 ||
+       options.poll_count > 0 || !options.shm_name.empty() ||
+       options.virtual_seconds > 0.0 || options.dashboard_hz > 0.0 ||
+       options.align_to_wall_clock ||
+       !options.trace_path.empty())) {
+    error = {"--burst and --soak only combine with --baud and --pacing", {}};
+    return false;
+  }
+  if (bus_options && options.device_count == 0) {
+    error = {"--bus-policy and --turnaround need --device", {}};
+    return false;
+  }
+  if (rts_option && options.device_count == 0 && options.poll_count == 0) {
+    error = {"--rts needs --device or --poll", {}};
+    return false;
+  }
+  if (poll_options && options.poll_count == 0) {
+    error = {"--registers and --response-timeout need --poll", {}};
+    return false;
+  }
+  if (options.poll_count > 0 &&
+      (options.device_count > 0 || options.stream_count > 0 ||
+       !options.shm_name.empty() || options.dashboard_hz > 0.0 ||
+       options.align_to_wall_clock || !options.trace_path.empty() ||
+       options.expected_hash || options.min_rate > 0.0)) {
+    error = {"--poll can't be combined with --device, --stream, --shm, "
+             "--dashboard, --align, --trace, --expect-hash or --min-rate",
+             {}};
+    return false;
+  }
+  if (options.device_count > 0 &&
+      (options.stream_count > 0 || !options.shm_name.empty() ||
+       options.dashboard_hz > 0.0 || options.align_to_wall_clock ||
+       !options.trace_path.empty())) {
+    error = {"--device can't be combined with --stream, --shm, "
+             "--dashboard, --align or --trace",
+             {}};
+    return false;
+  }
+  if (options.align_to_wall_clock &&
+      (options.stream_count > 0 || options.virtual_seconds > 0.0)) {
+    error = {"--align can't be combined with --stream or --virtual", {}};
+    return false;
+  }
+  if (options.shm_range > 0 && options.shm_name.empty()) {
+    error = {"--range needs --shm", {}};
+    return false;
+  }
+  if (options.stream_count > 0 && !options.shm_name.empty()) {
+    error = {"--stream can't be combined with --shm", {}};
+    return false;
+  }
+  // Only the single stream keeps a trace
+  if (options.stream_count > 0 && !options.trace_path.empty()) {
+    error = {"--stream can't be combined with --trace", {}};
+    return false;
+  }
+  if (options.placement.cpu >= 0 &&
+      (options.placement.numa_node >= 0 || options.placement.near_port)) {
+    error = {"--cpu can't be combined with --numa-node", {}};
+    return false;
+  }
+  if ((options.expected_hash || options.min_rate > 0.0) &&
+      options.virtual_seconds == 0.0) {
+    error = {"--expect-hash and --min-rate need --virtual", {}};
+    return false;
+  }
+  return true;
+}
+
+std::optional<LinkBudget> plan_link(const Options &options,
+                                    const PortSettings &settings) {
+  if (options.selftest || options.virtual_seconds > 0.0 || options.burst ||
+      options.soak_fill.count() > 0 || options.poll_count > 0)
+    return std::nullopt;
+
+  // Shared memory values are anywhere within --range, or any value
+  if (!options.shm_name.empty()) {
+    const auto range = options.shm_range;
+    const Values bounds{range, range, range, range};
+    return plan_link(options.format,
+                     worst_frame_size(options.format,
+                                      range > 0 ? &bounds : nullptr, true),
+                     settings, options.rate_hz);
+  }
+
+  const auto n = options.value;
+  const Values values{n, n, n, n};
+  const auto frame_bytes = worst_frame_size(options.format, &values, true);
+
+  // At worst no two streams share a frame, so every tick is a write. All
+  // ports carry the same streams at the same baud rate.
+  if (options.stream_count > 0) {
+    double total_rate = 0.0;
+    std::uint32_t used = 0;
+    for (std::size_t i = 0; i < options.stream_count; ++i) {
+      total_rate += options.streams[i].rate_hz;
+      used |= options.streams[i].channels;
+    }
+    if (used != 0xF)
+      total_rate += options.rate_hz;
+    return plan_link(options.format, frame_bytes, settings, total_rate);
+  }
+
+  // At worst every bus frame is a transmission of its own, with its
+  // device's address header. Headers count averaged over the frames and
+  // rounded up.
+  if (options.device_count > 0) {
+    double total_rate = 0.0;
+    double address_bytes = 0.0;
+    for (std::size_t i = 0; i < options.device_count; ++i) {
+      const auto &spec = options.devices[i];
+      const double rate_hz =
+          spec.rate_hz > 0.0 ? spec.rate_hz : options.rate_hz;
+      std::array<char, max_address_size> address;
+      const auto address_size =
+          encode_address(options.format, spec.address, frame_bytes, address);
+      total_rate += rate_hz;
+      address_bytes += rate_hz * static_cast<double>(address_size);
+    }
+    return plan_link(options.format,
+                     frame_bytes + static_cast<std::size_t>(
+                                       std::ceil(address_bytes / total_rate)),
+                     settings, total_rate);
+  }
+
+  return plan_link(options.format, frame_bytes, settings, options.rate_hz);
+}
+
+} // namespace excserial
@@ -0,0 +1,124 @@
+/**
+ * @file burst.cpp
+ * @brief Bursts of back-to-back frames for stress testing receivers.
+ */
+
+#include "excserial/burst.h"
+
+#include <algorithm>
+#include <windows.h>
+
+namespace excserial {
+
+namespace {
+
+constexpr auto stop_slice = std::chrono::milliseconds(50);
+
+} // namespace
+
+double BurstStats::throughput() const {
+  if (wire_time <= std::chrono::nanoseconds::zero())
+    return 0.0;
+  return static_cast<double>(bytes) /
+         std::chrono::duration<double>(wire_time).count();
+}
+
+void encode_burst(const Values &values, std::uint32_t frames, bool alternate,
+                  std::vector<char> &out, FrameFormat format) {
+  FrameBuffer frame;
+  FrameEncoder encoder{format};
+  std::int32_t sign = 1;
+  out.reserve(out.size() + frames * max_frame_size);
+  for (std::uint32_t i = 0; i < frames; ++i) {
+    Values signed_values = values;
+    for (auto &value : signed_values)
+      value *= sign;
+    const auto size = encoder.encode(signed_values, frame);
+    out.insert(out.end(), frame.begin(), frame.begin() + size);
+    if (alternate)
+      sign = -sign;
+  }
+}
+
+BurstSender::~BurstSender() {
+  stop();
+}
+
+bool BurstSender::start(Port &port, const BurstPattern &pattern,
+                        const Values &values, bool alternate,
+                        PacingMode pacing, FrameFormat format) {
+  stop();
+  if (pattern.frames == 0) {
+    error_ = "A burst needs at least one frame";
+    return false;
+  }
+  if (pattern.gap < std::chrono::nanoseconds::zero()) {
+    error_ = "Burst gap can't be negative";
+    return false;
+  }
+
+  port_ = &port;
+  pattern_ = pattern;
+  burst_.clear();
+  encode_burst(values, pattern.frames, alternate, burst_, format);
+  clock_.set_mode(pacing);
+  error_.clear();
+  bursts_ = 0;
+  wire_ns_ = 0;
+  stop_requested_ = false;
+  running_ = true;
+  thread_ = std::thread(&BurstSender::run, this);
+  return true;
+}
+
+void BurstSender::stop() {
+  stop_requested_ = true;
+  if (thread_.joinable())
+    thread_.join();
+}
+
+BurstStats BurstSender::stats() const {
+  BurstStats stats;
+  stats.bursts = bursts_.load(std::memory_order_relaxed);
+  stats.frames = stats.bursts * pattern_.frames;
+  stats.bytes = stats.bursts * burst_.size();
+  stats.wire_time =
+      std::chrono::nanoseconds{wire_ns_.load(std::memory_order_relaxed)};
+  return stats;
+}
+
+void BurstSender::run() {
+  std::uint32_t sent = 0;
+  while (!stop_requested_.load(std::memory_order_relaxed) &&
+         (pattern_.repetitions == 0 || sent < pattern_.repetitions)) {
+    const auto start = clock_.now();
+    if (!port_->write(burst_)) {
+      error_ = port_->error();
+      break;
+    }
+    // The write returns once the driver took the data, wait until it has
+    // left the queue. Bytes still in the UART FIFO are not seen.
+    while (port_->queued_bytes() > 0 &&
+           !stop_requested_.load(std::memory_order_relaxed))
+      Sleep(0);
+    const auto drained = clock_.now();
+
+    ++sent;
+    wire_ns_.fetch_add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(drained - start)
+            .count(),
+        std::memory_order_relaxed);
+    bursts_.fetch_add(1, std::memory_order_relaxed);
+
+    if (pattern_.repetitions != 0 && sent == pattern_.repetitions)
+      break;
+    // In slices, so stop() doesn't wait out a long gap
+    const auto resume = drained + pattern_.gap;
+    while (!stop_requested_.load(std::memory_order_relaxed) &&
+           clock_.now() < resume)
+      clock_.sleep_until(std::min(resume, clock_.now() + stop_slice));
+  }
+  running_.store(false, std::memory_order_release);
+}
+
+} // namespace excserial
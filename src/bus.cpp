@@ -0,0 +1,350 @@
+/**
+ * @file bus.cpp
+ * @brief Several addressed devices sharing one half-duplex RS-485 line.
+ */
+
+#include "excserial/bus.h"
+
+#include "excserial/link_budget.h"
+
+#include <algorithm>
+#include <charconv>
+
+namespace excserial {
+
+std::size_t encode_address(FrameFormat format, std::uint8_t address,
+                           std::size_t frame_size,
+                           std::span<char, max_address_size> out) {
+  if (format == FrameFormat::text) {
+    out[0] = '@';
+    const auto result =
+        std::to_chars(out.data() + 1, out.data() + out.size(), address);
+    return static_cast<std::size_t>(result.ptr - out.data());
+  }
+  out[0] = static_cast<char>(bus_address_mark);
+  out[1] = static_cast<char>(address);
+  out[2] = static_cast<char>(frame_size);
+  return 3;
+}
+
+std::string_view to_string(BusPolicy policy) {
+  switch (policy) {
+  case BusPolicy::round_robin:
+    return "round-robin";
+  case BusPolicy::priority:
+    return "priority";
+  }
+  return "unknown";
+}
+
+std::optional<BusPolicy> parse_bus_policy(std::string_view name) {
+  for (const auto policy : bus_policies) {
+    if (to_string(policy) == name)
+      return policy;
+  }
+  return std::nullopt;
+}
+
+std::string_view to_string(DirectionControl control) {
+  switch (control) {
+  case DirectionControl::none:
+    return "none";
+  case DirectionControl::driver:
+    return "driver";
+  case DirectionControl::manual:
+    return "manual";
+  }
+  return "unknown";
+}
+
+std::optional<DirectionControl> parse_direction_control(
+    std::string_view name) {
+  for (const auto control : direction_controls) {
+    if (to_string(control) == name)
+      return control;
+  }
+  return std::nullopt;
+}
+
+bool send_half_duplex(Port &port, Clock &clock, DirectionControl control,
+                      std::span<const char> data, double line_limit,
+                      Clock::time_point &released) {
+  const bool manual = control == DirectionControl::manual;
+  if (manual && !port.set_rts(true))
+    return false;
+  const auto start = clock.now();
+  if (!port.write(data)) {
+    if (manual)
+      port.set_rts(false);
+    return false;
+  }
+
+  released = start + wire_time(data.size(), line_limit);
+  if (!manual)
+    return true;
+  const auto character = wire_time(1, line_limit);
+  clock.sleep_until(released + character);
+  for (auto queued = port.queued_bytes(); queued > 0;
+       queued = port.queued_bytes())
+    clock.sleep_until(clock.now() + wire_time(queued, line_limit) + character);
+  if (!port.set_rts(false))
+    return false;
+  released = clock.now();
+  return true;
+}
+
+double BusStats::utilization() const {
+  if (elapsed <= std::chrono::nanoseconds::zero())
+    return 0.0;
+  return std::chrono::duration<double>(wire) /
+         std::chrono::duration<double>(elapsed);
+}
+
+BusScheduler::~BusScheduler() {
+  stop();
+}
+
+std::size_t BusScheduler::add_device(const BusDevice &device) {
+  auto &state = devices_.emplace_back();
+  state.config = device;
+  state.values.store(device.values);
+  return devices_.size() - 1;
+}
+
+void BusScheduler::update_values(std::size_t device, const Values &values) {
+  std::lock_guard lock(update_mutex_); // ValueSlot allows one writer
+  devices_[device].values.store(values);
+}
+
+bool BusScheduler::start(Port &port, double line_limit,
+                         std::uint64_t frame_limit) {
+  stop();
+  if (devices_.empty()) {
+    error_ = "No devices on the bus";
+    return false;
+  }
+  if (!(line_limit > 0.0)) {
+    error_ = "Line limit must be positive";
+    return false;
+  }
+  if (settings_.max_transmission != 0 &&
+      settings_.max_transmission < max_address_size + max_frame_size) {
+    error_ = "Transmission limit must hold the longest addressed frame";
+    return false;
+  }
+  for (auto device = devices_.begin(); device != devices_.end(); ++device) {
+    if (!device->config.period.positive()) {
+      error_ = "Device period must be positive";
+      return false;
+    }
+    if (std::any_of(devices_.begin(), device, [&](const auto &other) {
+          return other.config.address == device->config.address;
+        })) {
+      error_ = "Two devices share an address";
+      return false;
+    }
+  }
+  // Start listening, the first transmission raises RTS
+  if (settings_.direction == DirectionControl::manual &&
+      !port.set_rts(false)) {
+    error_ = port.error();
+    return false;
+  }
+
+  port_ = &port;
+  line_limit_ = line_limit;
+  error_.clear();
+  due_.clear();
+  due_.reserve(devices_.size());
+  transmission_.clear();
+  transmission_.reserve(devices_.size() *
+                        (max_address_size + max_frame_size));
+  next_turn_ = 0;
+  for (auto &device : devices_) {
+    device.encoder = FrameEncoder{format_};
+    device.offset = PeriodAccumulator{device.config.period};
+    device.sign = 1;
+    device.ticks = 0;
+    device.missed = 0;
+    device.lateness_sum_ns = 0;
+    device.lateness_max_ns = 0;
+  }
+  frames_ = 0;
+  transmissions_ = 0;
+  bytes_ = 0;
+  deferred_ = 0;
+  wire_ns_ = 0;
+  turnaround_ns_ = 0;
+  elapsed_ns_ = 0;
+  stop_requested_ = false;
+  running_ = true;
+  thread_ = std::thread(&BusScheduler::run, this, frame_limit);
+  return true;
+}
+
+void BusScheduler::stop() {
+  stop_requested_ = true;
+  if (thread_.joinable())
+    thread_.join();
+}
+
+BusStats BusScheduler::stats() const {
+  using std::chrono::nanoseconds;
+  BusStats stats;
+  stats.frames = frames_.load(std::memory_order_relaxed);
+  stats.transmissions = transmissions_.load(std::memory_order_relaxed);
+  stats.bytes = bytes_.load(std::memory_order_relaxed);
+  stats.deferred = deferred_.load(std::memory_order_relaxed);
+  stats.wire = nanoseconds{wire_ns_.load(std::memory_order_relaxed)};
+  stats.turnaround =
+      nanoseconds{turnaround_ns_.load(std::memory_order_relaxed)};
+  stats.elapsed = nanoseconds{elapsed_ns_.load(std::memory_order_relaxed)};
+  return stats;
+}
+
+StreamLateness BusScheduler::lateness(std::size_t index) const {
+  const auto &device = devices_[index];
+  StreamLateness lateness;
+  lateness.ticks = device.ticks.load(std::memory_order_relaxed);
+  lateness.missed = device.missed.load(std::memory_order_relaxed);
+  if (lateness.ticks > 0) {
+    lateness.mean_us = static_cast<double>(device.lateness_sum_ns.load(
+                           std::memory_order_relaxed)) /
+                       1e3 / static_cast<double>(lateness.ticks);
+  }
+  lateness.max_us =
+      static_cast<double>(
+          device.lateness_max_ns.load(std::memory_order_relaxed)) /
+      1e3;
+  return lateness;
+}
+
+void BusScheduler::order_due() {
+  if (settings_.policy == BusPolicy::priority) {
+    std::sort(due_.begin(), due_.end(), [&](std::size_t a, std::size_t b) {
+      const auto &first = devices_[a];
+      const auto &second = devices_[b];
+      if (first.config.priority != second.config.priority)
+        return first.config.priority > second.config.priority;
+      return first.offset.elapsed() < second.offset.elapsed();
+    });
+    return;
+  }
+  // Distance from the device whose turn it is, wrapping around
+  const auto count = devices_.size();
+  const auto turn = [&](std::size_t index) {
+    return (index + count - next_turn_) % count;
+  };
+  std::sort(due_.begin(), due_.end(), [&](std::size_t a, std::size_t b) {
+    return turn(a) < turn(b);
+  });
+}
+
+void BusScheduler::run(std::uint64_t frame_limit) {
+  const auto start = clock_->now();
+  for (auto &device : devices_)
+    device.offset.advance();
+  line_free_ = start;
+
+  FrameBuffer frame;
+  std::array<char, max_address_size> address;
+  std::uint64_t frames = 0;
+
+  while (!stop_requested_.load(std::memory_order_relaxed) &&
+         (frame_limit == 0 || frames < frame_limit)) {
+    // A handful of devices, a scan beats a timer wheel
+    auto next = start + devices_.front().offset.elapsed();
+    for (const auto &device : devices_)
+      next = std::min(next, start + device.offset.elapsed());
+    clock_->sleep_until(std::max(next, line_free_));
+    const auto now = clock_->now();
+
+    due_.clear();
+    for (std::size_t i = 0; i < devices_.size(); ++i) {
+      if (start + devices_[i].offset.elapsed() <= now)
+        due_.push_back(i);
+    }
+    order_due();
+
+    transmission_.clear();
+    for (const auto index : due_) {
+      if (frame_limit != 0 && frames >= frame_limit)
+        break;
+      auto &device = devices_[index];
+      auto values = device.values.load();
+      for (auto &value : values)
+        value *= device.sign;
+
+      // Delta state only moves on if the frame goes out
+      const auto encoder = device.encoder;
+      const auto size = device.encoder.encode(values, frame);
+      const auto header =
+          encode_address(format_, device.config.address, size, address);
+      if (settings_.max_transmission != 0 && !transmission_.empty() &&
+          transmission_.size() + header + size > settings_.max_transmission) {
+        device.encoder = encoder;
+        deferred_.fetch_add(1, std::memory_order_relaxed);
+        continue;
+      }
+
+      // Late by the time its first byte is on the wire
+      const auto on_wire =
+          now + wire_time(transmission_.size(), line_limit_);
+      const auto late = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            on_wire - (start + device.offset.elapsed()))
+                            .count();
+      device.lateness_sum_ns.fetch_add(late, std::memory_order_relaxed);
+      if (late > device.lateness_max_ns.load(std::memory_order_relaxed))
+        device.lateness_max_ns.store(late, std::memory_order_relaxed);
+      device.ticks.fetch_add(1, std::memory_order_relaxed);
+
+      transmission_.insert(transmission_.end(), address.begin(),
+                           address.begin() + header);
+      transmission_.insert(transmission_.end(), frame.begin(),
+                           frame.begin() + size);
+      if (device.config.alternate)
+        device.sign = -device.sign;
+      const auto behind = device.offset.advance_past(now - start) - 1;
+      if (behind > 0)
+        device.missed.fetch_add(behind, std::memory_order_relaxed);
+      next_turn_ = (index + 1) % devices_.size();
+      ++frames;
+    }
+    if (transmission_.empty())
+      continue;
+
+    if (!transmit(now)) {
+      stop_requested_ = true;
+      break;
+    }
+    frames_.store(frames, std::memory_order_relaxed);
+    elapsed_ns_.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          clock_->now() - start)
+                          .count(),
+                      std::memory_order_relaxed);
+  }
+  running_.store(false, std::memory_order_release);
+}
+
+bool BusScheduler::transmit(Clock::time_point now) {
+  Clock::time_point released;
+  if (!send_half_duplex(*port_, *clock_, settings_.direction, transmission_,
+                        line_limit_, released)) {
+    error_ = port_->error();
+    return false;
+  }
+  line_free_ = released + settings_.turnaround;
+
+  const auto wire = wire_time(transmission_.size(), line_limit_);
+  transmissions_.fetch_add(1, std::memory_order_relaxed);
+  bytes_.fetch_add(transmission_.size(), std::memory_order_relaxed);
+  wire_ns_.fetch_add(wire.count(), std::memory_order_relaxed);
+  turnaround_ns_.fetch_add(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(line_free_ - now -
+                                                           wire)
+          .count(),
+      std::memory_order_relaxed);
+  return true;
+}
+
+} // namespace excserial
@@ -0,0 +1,22 @@
+/**
+ * @file capture_port.cpp
+ * @brief Simulated port that fingerprints the byte stream.
+ */
+
+#include "excserial/capture_port.h"
+
+namespace excserial {
+
+bool CapturePort::write(std::span<const char> data) {
+  for (const char c : data) {
+    hash_ ^= static_cast<unsigned char>(c);
+    hash_ *= fnv_prime;
+  }
+  bytes_ += data.size();
+  ++writes_;
+  if (keep_data_)
+    data_.append(data.data(), data.size());
+  return true;
+}
+
+} // namespace excserial
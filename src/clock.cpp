@@ -0,0 +1,121 @@
+/**
+ * @file clock.cpp
+ * @brief Time source for the pacer, real or virtual.
+ */
+
+#include "excserial/clock.h"
+
+#include <thread>
+#include <windows.h>
+
+namespace excserial {
+
+std::string_view to_string(PacingMode mode) {
+  switch (mode) {
+  case PacingMode::spin:
+    return "spin";
+  case PacingMode::sleep:
+    return "sleep";
+  case PacingMode::hybrid:
+    return "hybrid";
+  case PacingMode::timer:
+    return "timer";
+  case PacingMode::adaptive:
+    return "adaptive";
+  }
+  return "unknown";
+}
+
+std::optional<PacingMode> parse_pacing_mode(std::string_view name) {
+  for (const auto mode : pacing_modes) {
+    if (to_string(mode) == name)
+      return mode;
+  }
+  return std::nullopt;
+}
+
+SteadyClock::SteadyClock(PacingMode mode) : mode_(mode) {
+  set_mode(mode);
+}
+
+SteadyClock::~SteadyClock() {
+  if (timer_ != nullptr)
+    CloseHandle(timer_);
+}
+
+void SteadyClock::set_mode(PacingMode mode) {
+  mode_ = mode;
+  if (mode_ == PacingMode::timer && timer_ == nullptr) {
+    // High resolution timers exist since Windows 10 1803, fall back to a
+    // regular one before that
+    timer_ = CreateWaitableTimerExW(nullptr, nullptr,
+                                    CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+                                    TIMER_ALL_ACCESS);
+    if (timer_ == nullptr)
+      timer_ = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+  }
+}
+
+void SteadyClock::sleep_until(time_point deadline) {
+  switch (mode_) {
+  case PacingMode::spin:
+    spin_until(deadline);
+    break;
+  case PacingMode::sleep:
+    std::this_thread::sleep_until(deadline);
+    break;
+  case PacingMode::hybrid:
+    if (deadline - now() > spin_window_)
+      std::this_thread::sleep_until(deadline - spin_window_);
+    spin_until(deadline);
+    break;
+  case PacingMode::timer:
+    timer_wait_until(deadline);
+    break;
+  case PacingMode::adaptive:
+    adaptive_wait_until(deadline);
+    break;
+  }
+}
+
+void SteadyClock::spin_until(time_point deadline) {
+  // Busy wait since windows can't do sub 16 ms sleep with chrono
+  spin_turns_ += excserial::spin_until(deadline, spin_mode_);
+}
+
+void SteadyClock::adaptive_wait_until(time_point deadline) {
+  const auto wake_target = deadline - tuner_.window();
+  if (now() < wake_target) {
+    std::this_thread::sleep_until(wake_target);
+    // Overshoot past the wake target is what the spin has to absorb
+    tuner_.add(now() - wake_target);
+  }
+  spin_until(deadline);
+}
+
+void SteadyClock::timer_wait_until(time_point deadline) {
+  const auto remaining = deadline - now();
+  if (remaining <= std::chrono::nanoseconds::zero())
+    return;
+  if (timer_ == nullptr) {
+    spin_until(deadline);
+    return;
+  }
+
+  // Negative due time is relative, in 100 ns units rounded up so the
+  // timer can't fire before the deadline
+  using hundred_ns =
+      std::chrono::duration<LONGLONG, std::ratio<1, 10'000'000>>;
+  LARGE_INTEGER due;
+  due.QuadPart = -std::chrono::ceil<hundred_ns>(remaining).count();
+  if (!SetWaitableTimer(timer_, &due, 0, nullptr, nullptr, FALSE)) {
+    spin_until(deadline);
+    return;
+  }
+  WaitForSingleObject(timer_, INFINITE);
+  // The timer counts on the interrupt clock, not on now(), finish exactly
+  if (now() < deadline)
+    spin_until(deadline);
+}
+
+} // namespace excserial
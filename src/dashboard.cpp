@@ -0,0 +1,189 @@
+/**
+ * @file dashboard.cpp
+ * @brief Full screen terminal view of many ports.
+ */
+
+#include "excserial/dashboard.h"
+
+#include "excserial/scheduler.h"
+#include "excserial/stream.h"
+
+#include <algorithm>
+#include <format>
+#include <iterator>
+#include <windows.h>
+
+namespace excserial {
+
+namespace {
+
+constexpr std::size_t header_lines = 3; ///< Title, blank, column names
+
+/// Formats into a screen line, padding with blanks and cutting at its end.
+template <typename Line, typename... Args>
+void print(Line &line, std::format_string<Args...> format, Args &&...args) {
+  const auto result =
+      std::format_to_n(line.data(), static_cast<std::ptrdiff_t>(line.size()),
+                       format, std::forward<Args>(args)...);
+  const auto used = std::min<std::ptrdiff_t>(
+      result.size, static_cast<std::ptrdiff_t>(line.size()));
+  std::fill(line.begin() + used, line.end(), ' ');
+}
+
+void write_console(HANDLE console, std::string_view text) {
+  DWORD written = 0;
+  WriteFile(console, text.data(), static_cast<DWORD>(text.size()), &written,
+            nullptr);
+}
+
+} // namespace
+
+Dashboard::~Dashboard() {
+  stop();
+}
+
+void Dashboard::add_port(std::string name, Sample sample) {
+  rows_.push_back({std::move(name), std::move(sample), {}});
+}
+
+void Dashboard::add_stream(std::string name, Stream &stream) {
+  add_port(std::move(name), [&stream](PortSample &sample) {
+    sample.frames = stream.frames_sent();
+    sample.bytes = stream.bytes_sent();
+    stream.lateness().snapshot(sample.lateness);
+    const auto telemetry = stream.telemetry();
+    sample.queued_bytes = telemetry.queued_bytes;
+    sample.sent_values = telemetry.sent_values;
+    // Sampled by the send thread in time for the next refresh
+    stream.request_telemetry();
+  });
+}
+
+void Dashboard::add_scheduled_port(std::string name,
+                                   MultiRateScheduler &scheduler,
+                                   std::size_t port) {
+  add_port(std::move(name), [&scheduler, port](PortSample &sample) {
+    const auto counters = scheduler.port_counters(port);
+    sample.frames = counters.frames;
+    sample.bytes = counters.bytes;
+    scheduler.port_lateness(port).snapshot(sample.lateness);
+    const auto telemetry = scheduler.port_telemetry(port);
+    sample.queued_bytes = telemetry.queued_bytes;
+    sample.sent_values = telemetry.sent_values;
+    // Every row asks, the scheduler thread samples all ports at once
+    scheduler.request_telemetry();
+  });
+}
+
+void Dashboard::start(std::chrono::milliseconds period) {
+  stop();
+  period_ = period;
+  stop_requested_ = false;
+  thread_ = std::thread(&Dashboard::run, this);
+}
+
+void Dashboard::stop() {
+  {
+    std::lock_guard lock(mutex_);
+    stop_requested_ = true;
+  }
+  wake_.notify_one();
+  if (thread_.joinable())
+    thread_.join();
+}
+
+void Dashboard::render(std::vector<Line> &screen, double seconds) {
+  print(screen[0], "excserial  {} port{}  refresh {} ms", rows_.size(),
+        rows_.size() == 1 ? "" : "s", period_.count());
+  print(screen[1], "");
+  print(screen[2], "{:<14}{:>10}{:>11}{:>9}{:>9}{:>9}{:>8}  {}", "port",
+        "frames/s", "bytes/s", "p50 us", "p99 us", "max us", "queue",
+        "sent values");
+
+  for (std::size_t i = 0; i < rows_.size(); ++i) {
+    auto &row = rows_[i];
+    PortSample sample;
+    row.sample(sample);
+
+    // Rates and percentiles over the last refresh period only
+    LatenessHistogram::Counts lateness;
+    for (std::size_t bucket = 0; bucket < lateness.size(); ++bucket)
+      lateness[bucket] = sample.lateness[bucket] - row.last.lateness[bucket];
+    const auto &values = sample.sent_values;
+    print(screen[header_lines + i],
+          "{:<14}{:>10.1f}{:>11.0f}{:>9.0f}{:>9.0f}{:>9.0f}{:>8}  "
+          "{} {} {} {}",
+          row.name,
+          static_cast<double>(sample.frames - row.last.frames) / seconds,
+          static_cast<double>(sample.bytes - row.last.bytes) / seconds,
+          LatenessHistogram::quantile_us(lateness, 0.5),
+          LatenessHistogram::quantile_us(lateness, 0.99),
+          LatenessHistogram::quantile_us(lateness, 1.0), sample.queued_bytes,
+          values[0], values[1], values[2], values[3]);
+    row.last = sample;
+  }
+}
+
+void Dashboard::draw(const std::vector<Line> &screen,
+                     const std::vector<Line> &previous, std::string &output) {
+  // Per line, only the span from the first to the last changed column
+  for (std::size_t row = 0; row < screen.size(); ++row) {
+    const auto &line = screen[row];
+    const auto &before = previous[row];
+    const auto first =
+        std::mismatch(line.begin(), line.end(), before.begin()).first;
+    if (first == line.end())
+      continue;
+    const auto last =
+        std::mismatch(line.rbegin(), line.rend(), before.rbegin()).first.base();
+    std::format_to(std::back_inserter(output), "\x1b[{};{}H", row + 1,
+                   first - line.begin() + 1);
+    output.append(first, last);
+  }
+}
+
+void Dashboard::run() {
+  SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+  HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+  DWORD console_mode = 0;
+  const bool has_mode = GetConsoleMode(console, &console_mode) != 0;
+  if (has_mode) {
+    SetConsoleMode(console,
+                   console_mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+  }
+
+  // Sized once, a refresh only reuses them
+  const auto lines = header_lines + rows_.size();
+  std::vector<Line> screen(lines);
+  std::vector<Line> previous(lines);
+  for (auto &line : previous)
+    line.fill(' ');
+  std::string output;
+  output.reserve(lines * (width + 16));
+
+  // Alternate screen, cursor hidden, cleared to match previous
+  write_console(console, "\x1b[?1049h\x1b[?25l\x1b[2J");
+  for (auto &row : rows_)
+    row.sample(row.last);
+
+  auto last_time = std::chrono::steady_clock::now();
+  std::unique_lock lock(mutex_);
+  while (!wake_.wait_for(lock, period_, [this] { return stop_requested_; })) {
+    const auto now = std::chrono::steady_clock::now();
+    const std::chrono::duration<double> elapsed = now - last_time;
+    last_time = now;
+
+    render(screen, elapsed.count());
+    output.clear();
+    draw(screen, previous, output);
+    if (!output.empty())
+      write_console(console, output);
+    std::swap(screen, previous);
+  }
+
+  write_console(console, "\x1b[?25h\x1b[?1049l");
+  if (has_mode)
+    SetConsoleMode(console, console_mode);
+}
+
+} // namespace excserial
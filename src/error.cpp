@@ -0,0 +1,29 @@
+/**
+ * @file error.cpp
+ * @brief Windows error code formatting.
+ */
+
+#include "excserial/error.h"
+
+namespace excserial {
+
+std::string error_string(DWORD error_code) {
+  char *buffer = nullptr;
+  const DWORD len = ::FormatMessageA(
+      FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM |
+          FORMAT_MESSAGE_IGNORE_INSERTS,
+      nullptr, error_code, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
+      reinterpret_cast<char *>(&buffer), 0, nullptr);
+
+  if (len == 0 || buffer == nullptr)
+    return "Unknown error (" + std::to_string(error_code) + ")";
+
+  std::string result{buffer};
+  ::LocalFree(buffer);
+  // Remove trailing CRLF
+  while (!result.empty() && (result.back() == '\r' || result.back() == '\n'))
+    result.pop_back();
+  return result;
+}
+
+} // namespace excserial
@@ -0,0 +1,146 @@
+/**
+ * @file frame.cpp
+ * @brief Frame encoding for the channel values sent to the MCU.
+ */
+
+#include "excserial/frame.h"
+
+#include "excserial_delta.h"
+
+#include <algorithm>
+#include <charconv>
+
+namespace excserial {
+
+std::size_t encode_text_frame(const Values &values,
+                              std::span<char, max_frame_size> out) {
+  char *pos = out.data();
+  char *const end = pos + out.size();
+  *pos++ = '#';
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    if (i > 0)
+      *pos++ = ',';
+    // Buffer is sized for the worst case, this can't fail
+    pos = std::to_chars(pos, end, values[i]).ptr;
+  }
+  *pos++ = ';';
+  return static_cast<std::size_t>(pos - out.data());
+}
+
+std::string_view to_string(FrameFormat format) {
+  switch (format) {
+  case FrameFormat::text:
+    return "text";
+  case FrameFormat::binary:
+    return "binary";
+  case FrameFormat::delta:
+    return "delta";
+  }
+  return "unknown";
+}
+
+std::optional<FrameFormat> parse_frame_format(std::string_view name) {
+  for (const auto format : frame_formats) {
+    if (to_string(format) == name)
+      return format;
+  }
+  return std::nullopt;
+}
+
+std::size_t encode_binary_frame(const Values &values,
+                                std::span<char, max_frame_size> out) {
+  unsigned char *pos = reinterpret_cast<unsigned char *>(out.data());
+  *pos++ = binary_frame_sync;
+  unsigned char check = 0;
+  for (const auto value : values) {
+    const auto bits = static_cast<std::uint32_t>(value);
+    for (int shift = 0; shift < 32; shift += 8) {
+      const auto byte = static_cast<unsigned char>(bits >> shift);
+      check ^= byte;
+      *pos++ = byte;
+    }
+  }
+  *pos = check;
+  return binary_frame_size;
+}
+
+namespace {
+
+static_assert(EXCSERIAL_DELTA_CHANNELS == channel_count);
+static_assert(EXCSERIAL_DELTA_MAX_SIZE <= max_frame_size);
+
+/// Header, one zigzag varint per channel and the XOR check byte.
+std::size_t encode_delta(unsigned char header, const Values &changes,
+                         std::span<char, max_frame_size> out) {
+  unsigned char *pos = reinterpret_cast<unsigned char *>(out.data());
+  unsigned char check = header;
+  *pos++ = header;
+  for (const auto change : changes) {
+    const auto bits = static_cast<std::uint32_t>(change);
+    auto zigzag = (bits << 1) ^ (change < 0 ? ~0u : 0u);
+    do {
+      auto byte = static_cast<unsigned char>(zigzag & 0x7F);
+      zigzag >>= 7;
+      if (zigzag != 0)
+        byte |= 0x80;
+      check ^= byte;
+      *pos++ = byte;
+    } while (zigzag != 0);
+  }
+  *pos++ = check;
+  return static_cast<std::size_t>(pos - reinterpret_cast<unsigned char *>(
+                                            out.data()));
+}
+
+} // namespace
+
+std::size_t encode_key_frame(const Values &values,
+                             std::span<char, max_frame_size> out) {
+  return encode_delta(EXCSERIAL_DELTA_KEY, values, out);
+}
+
+std::size_t encode_step_frame(const Values &previous, const Values &values,
+                              std::span<char, max_frame_size> out) {
+  // Changes wrap in 32 bits, like the decoder adds them back
+  Values changes;
+  std::transform(values.begin(), values.end(), previous.begin(),
+                 changes.begin(), [](std::int32_t to, std::int32_t from) {
+                   return static_cast<std::int32_t>(
+                       static_cast<std::uint32_t>(to) -
+                       static_cast<std::uint32_t>(from));
+                 });
+  return encode_delta(EXCSERIAL_DELTA_STEP, changes, out);
+}
+
+std::size_t encode_frame(FrameFormat format, const Values &values,
+                         std::span<char, max_frame_size> out) {
+  switch (format) {
+  case FrameFormat::binary:
+    return encode_binary_frame(values, out);
+  case FrameFormat::delta:
+    return encode_key_frame(values, out);
+  case FrameFormat::text:
+    break;
+  }
+  return encode_text_frame(values, out);
+}
+
+FrameEncoder::FrameEncoder(FrameFormat format,
+                           std::uint32_t keyframe_interval)
+    : format_(format), keyframe_interval_(std::max(keyframe_interval, 1u)) {
+}
+
+std::size_t FrameEncoder::encode(const Values &values,
+                                 std::span<char, max_frame_size> out) {
+  if (format_ != FrameFormat::delta)
+    return encode_frame(format_, values, out);
+
+  const auto size = since_key_ == 0
+                        ? encode_key_frame(values, out)
+                        : encode_step_frame(previous_, values, out);
+  previous_ = values;
+  since_key_ = since_key_ + 1 == keyframe_interval_ ? 0 : since_key_ + 1;
+  return size;
+}
+
+} // namespace excserial
@@ -0,0 +1,46 @@
+/**
+ * @file heap_counter.cpp
+ * @brief Global operator new and delete that count allocations per thread.
+ *
+ * Linked into the excserial executable and the tests only, as the
+ * excserial_heap_counter object library, see count_heap_allocation(). Array
+ * and nothrow forms end up here too.
+ */
+
+#include "excserial/arena.h"
+
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+
+void *operator new(std::size_t size) {
+  excserial::count_heap_allocation();
+  if (void *memory = std::malloc(size == 0 ? 1 : size))
+    return memory;
+  throw std::bad_alloc();
+}
+
+// Over-aligned types, and the arena's heap fallback
+void *operator new(std::size_t size, std::align_val_t alignment) {
+  excserial::count_heap_allocation();
+  if (void *memory = _aligned_malloc(size == 0 ? 1 : size,
+                                     static_cast<std::size_t>(alignment)))
+    return memory;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept {
+  std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept {
+  std::free(memory);
+}
+
+void operator delete(void *memory, std::align_val_t) noexcept {
+  _aligned_free(memory);
+}
+
+void operator delete(void *memory, std::size_t, std::align_val_t) noexcept {
+  _aligned_free(memory);
+}
@@ -0,0 +1,72 @@
+/**
+ * @file histogram.cpp
+ * @brief Microsecond latency histogram with logarithmic buckets.
+ */
+
+#include "excserial/histogram.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+namespace excserial {
+
+namespace log_buckets {
+
+std::size_t of(std::int64_t us) {
+  if (us < 8)
+    return static_cast<std::size_t>(std::max<std::int64_t>(us, 0));
+  const auto value = static_cast<std::uint64_t>(us);
+  const auto octave = static_cast<std::size_t>(std::bit_width(value)) - 1;
+  const auto sub = static_cast<std::size_t>(value >> (octave - 3)) & 7;
+  return std::min(8 + (octave - 3) * 8 + sub, count - 1);
+}
+
+std::int64_t upper_us(std::size_t bucket) {
+  if (bucket < 8)
+    return static_cast<std::int64_t>(bucket) + 1;
+  const auto octave = (bucket - 8) / 8 + 3;
+  const auto sub = (bucket - 8) % 8;
+  return static_cast<std::int64_t>(9 + sub) << (octave - 3);
+}
+
+} // namespace log_buckets
+
+void LatenessHistogram::add(std::chrono::nanoseconds lateness) {
+  const auto us =
+      std::chrono::duration_cast<std::chrono::microseconds>(lateness).count();
+  auto &count = counts_[log_buckets::of(us)];
+  // Single writer, a plain increment is enough and avoids a locked add
+  count.store(count.load(std::memory_order_relaxed) + 1,
+              std::memory_order_relaxed);
+}
+
+void LatenessHistogram::reset() {
+  for (auto &count : counts_)
+    count.store(0, std::memory_order_relaxed);
+}
+
+void LatenessHistogram::snapshot(Counts &counts) const {
+  for (std::size_t i = 0; i < log_buckets::count; ++i)
+    counts[i] = counts_[i].load(std::memory_order_relaxed);
+}
+
+double LatenessHistogram::quantile_us(const Counts &counts, double quantile) {
+  std::uint64_t total = 0;
+  for (const auto count : counts)
+    total += count;
+  if (total == 0)
+    return 0.0;
+  const auto target = static_cast<std::uint64_t>(
+      std::ceil(quantile * static_cast<double>(total)));
+  std::uint64_t seen = 0;
+  std::size_t bucket = 0;
+  for (; bucket < log_buckets::count - 1; ++bucket) {
+    seen += counts[bucket];
+    if (seen >= std::max<std::uint64_t>(target, 1))
+      break;
+  }
+  return static_cast<double>(log_buckets::upper_us(bucket));
+}
+
+} // namespace excserial
@@ -0,0 +1,137 @@
+/**
+ * @file link_budget.cpp
+ * @brief What frame rate a serial line can carry.
+ */
+
+#include "excserial/link_budget.h"
+
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <limits>
+
+namespace excserial {
+
+namespace {
+
+/// Rates common USB and PCIe UARTs support.
+constexpr std::uint32_t standard_baud_rates[] = {
+    9600,   19200,  38400,   57600,   115200,  230400,
+    460800, 921600, 1000000, 2000000, 3000000};
+
+} // namespace
+
+double bits_per_byte(const PortSettings &settings) {
+  // ONESTOPBIT, ONE5STOPBITS and TWOSTOPBITS are 0, 1 and 2
+  const double stop_bits = 1.0 + 0.5 * settings.stop_bits;
+  const double parity_bits = settings.parity == NOPARITY ? 0.0 : 1.0;
+  return 1.0 + settings.byte_size + parity_bits + stop_bits;
+}
+
+double line_limit(const PortSettings &settings) {
+  return settings.baud_rate / bits_per_byte(settings);
+}
+
+std::chrono::nanoseconds wire_time(std::size_t bytes, double line_limit) {
+  return std::chrono::nanoseconds{
+      std::llround(static_cast<double>(bytes) * 1e9 / line_limit)};
+}
+
+std::size_t worst_frame_size(FrameFormat format, const Values *values,
+                             bool alternate,
+                             std::span<const std::int32_t> trajectory) {
+  FrameBuffer frame;
+  if (values == nullptr && trajectory.empty()) {
+    // Any value, and for delta frames any change
+    constexpr auto lowest = std::numeric_limits<std::int32_t>::min();
+    return encode_frame(format, {lowest, lowest, lowest, lowest}, frame);
+  }
+
+  // Values of the n-th frame the stream sends
+  const Values fixed = values != nullptr ? *values : Values{};
+  const auto rows =
+      trajectory.empty() ? 1 : trajectory.size() / channel_count;
+  const auto frame_values = [&](std::size_t n) {
+    Values result = fixed;
+    if (!trajectory.empty())
+      std::copy_n(trajectory.begin() + n % rows * channel_count,
+                  channel_count, result.begin());
+    if (alternate && n % 2 == 1) {
+      for (auto &value : result)
+        value = -value;
+    }
+    return result;
+  };
+  const auto cycle = rows * (alternate ? 2 : 1);
+
+  if (format != FrameFormat::delta) {
+    std::size_t size = 0;
+    for (std::size_t n = 0; n < cycle; ++n)
+      size = std::max(size, encode_frame(format, frame_values(n), frame));
+    return size;
+  }
+
+  // Delta frames vary in size, the busiest key frame interval counts
+  constexpr std::size_t interval = default_keyframe_interval;
+  const auto frames = (std::max(cycle, interval) + interval - 1) /
+                      interval * interval;
+  FrameEncoder encoder{FrameFormat::delta};
+  std::size_t busiest = 0;
+  std::size_t bytes = 0;
+  for (std::size_t n = 0; n < frames; ++n) {
+    bytes += encoder.encode(frame_values(n), frame);
+    if ((n + 1) % interval == 0) {
+      busiest = std::max(busiest, bytes);
+      bytes = 0;
+    }
+  }
+  return (busiest + interval - 1) / interval;
+}
+
+LinkBudget plan_link(FrameFormat format, std::size_t frame_bytes,
+                     const PortSettings &settings, double rate_hz) {
+  LinkBudget budget;
+  budget.format = format;
+  budget.frame_bytes = frame_bytes;
+  budget.bits_per_byte = bits_per_byte(settings);
+  budget.max_rate_hz =
+      line_limit(settings) / static_cast<double>(frame_bytes);
+  budget.rate_hz = rate_hz;
+  budget.baud_rate = settings.baud_rate;
+  return budget;
+}
+
+std::string link_advice(const LinkBudget &budget) {
+  if (budget.has_headroom())
+    return {};
+
+  const auto load = [&budget](std::size_t frame_bytes, std::uint32_t baud) {
+    return budget.rate_hz * static_cast<double>(frame_bytes) *
+           budget.bits_per_byte / baud;
+  };
+  // Small values make shorter text frames than binary ones
+  const bool text = budget.format == FrameFormat::text &&
+                    budget.frame_bytes > binary_frame_size;
+  if (text && load(binary_frame_size, budget.baud_rate) <= link_headroom_load)
+    return std::format("binary frames need {:.0f}% of the line",
+                       load(binary_frame_size, budget.baud_rate) * 100.0);
+  for (const auto baud : standard_baud_rates) {
+    if (baud > budget.baud_rate &&
+        load(budget.frame_bytes, baud) <= link_headroom_load)
+      return std::format("{} baud needs {:.0f}% of the line", baud,
+                         load(budget.frame_bytes, baud) * 100.0);
+  }
+  for (const auto baud : standard_baud_rates) {
+    if (text && baud > budget.baud_rate &&
+        load(binary_frame_size, baud) <= link_headroom_load)
+      return std::format("binary frames at {} baud need {:.0f}% of the line",
+                         baud, load(binary_frame_size, baud) * 100.0);
+  }
+  return std::format("no standard baud rate carries {} Hz, stay below "
+                     "{:.0f} Hz at {} baud",
+                     budget.rate_hz,
+                     budget.max_rate_hz * link_headroom_load,
+                     budget.baud_rate);
+}
+
+} // namespace excserial
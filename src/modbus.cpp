@@ -0,0 +1,382 @@
+/**
+ * @file modbus.cpp
+ * @brief Polling Modbus RTU slaves that only answer when asked.
+ */
+
+#include "excserial/modbus.h"
+
+#include "excserial/link_budget.h"
+
+#include <algorithm>
+#include <array>
+
+namespace excserial {
+
+namespace {
+
+constexpr auto crc_table = [] {
+  std::array<std::uint16_t, 256> table{};
+  for (std::uint32_t byte = 0; byte < 256; ++byte) {
+    auto crc = static_cast<std::uint16_t>(byte);
+    for (int bit = 0; bit < 8; ++bit)
+      crc = (crc & 1) ? static_cast<std::uint16_t>((crc >> 1) ^ 0xA001)
+                      : static_cast<std::uint16_t>(crc >> 1);
+    table[byte] = crc;
+  }
+  return table;
+}();
+
+/// Above this the character based gaps are fixed.
+constexpr std::uint32_t fixed_gap_baud = 19200;
+
+} // namespace
+
+std::uint16_t modbus_crc(std::span<const unsigned char> data) {
+  std::uint16_t crc = 0xFFFF;
+  for (const auto byte : data)
+    crc = static_cast<std::uint16_t>((crc >> 8) ^
+                                     crc_table[(crc ^ byte) & 0xFF]);
+  return crc;
+}
+
+ModbusTiming modbus_timing(const PortSettings &settings) {
+  ModbusTiming timing;
+  timing.character = wire_time(1, line_limit(settings));
+  if (settings.baud_rate > fixed_gap_baud) {
+    timing.end_of_frame = std::chrono::microseconds(750);
+    timing.silence = std::chrono::microseconds(1750);
+  } else {
+    timing.end_of_frame = timing.character * 3 / 2;
+    timing.silence = timing.character * 7 / 2;
+  }
+  return timing;
+}
+
+std::chrono::nanoseconds modbus_read_cycle(const PortSettings &settings,
+                                           std::uint16_t count) {
+  const double limit = line_limit(settings);
+  return wire_time(modbus_request_size, limit) +
+         wire_time(modbus_read_response_size(count), limit) +
+         2 * modbus_timing(settings).silence;
+}
+
+void encode_read_request(std::uint8_t slave, ModbusFunction function,
+                         std::uint16_t address, std::uint16_t count,
+                         std::span<char, modbus_request_size> out) {
+  const std::array<unsigned char, modbus_request_size - 2> body = {
+      slave,
+      static_cast<unsigned char>(function),
+      static_cast<unsigned char>(address >> 8),
+      static_cast<unsigned char>(address),
+      static_cast<unsigned char>(count >> 8),
+      static_cast<unsigned char>(count)};
+  const auto crc = modbus_crc(body);
+  std::copy(body.begin(), body.end(), out.begin());
+  out[6] = static_cast<char>(crc);
+  out[7] = static_cast<char>(crc >> 8);
+}
+
+std::string_view to_string(ModbusResult result) {
+  switch (result) {
+  case ModbusResult::ok:
+    return "ok";
+  case ModbusResult::timeout:
+    return "timeout";
+  case ModbusResult::bad_frame:
+    return "bad frame";
+  case ModbusResult::exception:
+    return "exception";
+  case ModbusResult::mismatch:
+    return "mismatch";
+  }
+  return "unknown";
+}
+
+ModbusResult parse_read_response(std::span<const unsigned char> response,
+                                 std::uint8_t slave, ModbusFunction function,
+                                 std::span<std::uint16_t> registers,
+                                 std::uint8_t &exception_code) {
+  if (response.empty())
+    return ModbusResult::timeout;
+  // The CRC over a frame including its own CRC is 0
+  if (response.size() < 5 || modbus_crc(response) != 0)
+    return ModbusResult::bad_frame;
+  if (response[0] != slave ||
+      (response[1] & 0x7F) != static_cast<unsigned char>(function))
+    return ModbusResult::mismatch;
+  if (response[1] & 0x80) {
+    if (response.size() != 5)
+      return ModbusResult::bad_frame;
+    exception_code = response[2];
+    return ModbusResult::exception;
+  }
+
+  const auto count = static_cast<std::uint16_t>(registers.size());
+  if (response.size() != modbus_read_response_size(count) ||
+      response[2] != 2 * count)
+    return ModbusResult::bad_frame;
+  for (std::size_t i = 0; i < registers.size(); ++i) {
+    registers[i] = static_cast<std::uint16_t>(response[3 + 2 * i] << 8 |
+                                              response[4 + 2 * i]);
+  }
+  return ModbusResult::ok;
+}
+
+ModbusPoller::~ModbusPoller() {
+  stop();
+}
+
+std::size_t ModbusPoller::add_poll(const ModbusPoll &poll) {
+  auto &state = polls_.emplace_back();
+  state.config = poll;
+  state.registers.assign(poll.count, 0);
+  return polls_.size() - 1;
+}
+
+bool ModbusPoller::start(Port &port, const PortSettings &line,
+                         std::uint64_t request_limit) {
+  stop();
+  if (polls_.empty()) {
+    error_ = "Nothing to poll";
+    return false;
+  }
+  if (settings_.response_timeout <= std::chrono::nanoseconds::zero()) {
+    error_ = "Response timeout must be positive";
+    return false;
+  }
+  for (const auto &poll : polls_) {
+    if (poll.config.count == 0 || poll.config.count > modbus_max_registers) {
+      error_ = "A read is 1 to 125 registers";
+      return false;
+    }
+    if (std::uint32_t{poll.config.address} + poll.config.count > 0x10000) {
+      error_ = "Registers beyond address 65535";
+      return false;
+    }
+    if (!poll.config.period.positive()) {
+      error_ = "Poll period must be positive";
+      return false;
+    }
+  }
+  if (settings_.direction == DirectionControl::manual &&
+      !port.set_rts(false)) {
+    error_ = port.error();
+    return false;
+  }
+
+  port_ = &port;
+  timing_ = modbus_timing(line);
+  line_limit_ = line_limit(line);
+  response_.clear();
+  response_.reserve(modbus_max_frame_size);
+  decoded_.assign(modbus_max_registers, 0);
+  error_.clear();
+  for (auto &poll : polls_) {
+    poll.offset = PeriodAccumulator{poll.config.period};
+    poll.requests = 0;
+    poll.responses = 0;
+    poll.timeouts = 0;
+    poll.bad_frames = 0;
+    poll.exceptions = 0;
+    poll.mismatches = 0;
+    poll.missed = 0;
+    poll.latency_sum_ns = 0;
+    poll.latency_max_ns = 0;
+    poll.last_exception = 0;
+  }
+  stray_bytes_ = 0;
+  elapsed_ns_ = 0;
+  stop_requested_ = false;
+  running_ = true;
+  thread_ = std::thread(&ModbusPoller::run, this, request_limit);
+  return true;
+}
+
+void ModbusPoller::stop() {
+  stop_requested_ = true;
+  if (thread_.joinable())
+    thread_.join();
+}
+
+PollStats ModbusPoller::stats(std::size_t index) const {
+  const auto &poll = polls_[index];
+  PollStats stats;
+  stats.requests = poll.requests.load(std::memory_order_relaxed);
+  stats.responses = poll.responses.load(std::memory_order_relaxed);
+  stats.timeouts = poll.timeouts.load(std::memory_order_relaxed);
+  stats.bad_frames = poll.bad_frames.load(std::memory_order_relaxed);
+  stats.exceptions = poll.exceptions.load(std::memory_order_relaxed);
+  stats.mismatches = poll.mismatches.load(std::memory_order_relaxed);
+  stats.missed = poll.missed.load(std::memory_order_relaxed);
+  if (stats.responses > 0) {
+    stats.latency_mean_us =
+        static_cast<double>(
+            poll.latency_sum_ns.load(std::memory_order_relaxed)) /
+        1e3 / static_cast<double>(stats.responses);
+  }
+  stats.latency_max_us =
+      static_cast<double>(poll.latency_max_ns.load(std::memory_order_relaxed)) /
+      1e3;
+  stats.last_exception = poll.last_exception.load(std::memory_order_relaxed);
+  return stats;
+}
+
+std::vector<std::uint16_t> ModbusPoller::registers(std::size_t index) const {
+  std::lock_guard lock(registers_mutex_);
+  return polls_[index].registers;
+}
+
+void ModbusPoller::run(std::uint64_t request_limit) {
+  const auto start = clock_->now();
+  for (auto &poll : polls_)
+    poll.offset.advance();
+  line_free_ = start;
+  std::uint64_t requests = 0;
+
+  while (!stop_requested_.load(std::memory_order_relaxed) &&
+         (request_limit == 0 || requests < request_limit)) {
+    // Earliest deadline first, a poll that is behind doesn't starve the rest
+    auto *next = &polls_.front();
+    for (auto &poll : polls_) {
+      if (poll.offset.elapsed() < next->offset.elapsed())
+        next = &poll;
+    }
+    clock_->sleep_until(std::max(start + next->offset.elapsed(), line_free_));
+
+    if (!poll(*next)) {
+      stop_requested_ = true;
+      break;
+    }
+    ++requests;
+
+    // Skip the periods that passed while the bus was busy
+    const auto now = clock_->now();
+    const auto behind = next->offset.advance_past(now - start) - 1;
+    if (behind > 0)
+      next->missed.fetch_add(behind, std::memory_order_relaxed);
+    elapsed_ns_.store(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(now - start)
+            .count(),
+        std::memory_order_relaxed);
+  }
+  running_.store(false, std::memory_order_release);
+}
+
+bool ModbusPoller::poll(PollState &poll) {
+  const auto &config = poll.config;
+  if (!discard_input())
+    return false;
+
+  std::array<char, modbus_request_size> request;
+  encode_read_request(config.slave, config.function, config.address,
+                      config.count, request);
+  const auto sent = clock_->now();
+  Clock::time_point released;
+  if (!send_half_duplex(*port_, *clock_, settings_.direction, request,
+                        line_limit_, released)) {
+    error_ = port_->error();
+    return false;
+  }
+  poll.requests.fetch_add(1, std::memory_order_relaxed);
+
+  if (!receive(modbus_read_response_size(config.count),
+               released + settings_.response_timeout))
+    return false;
+  const auto done = clock_->now();
+  line_free_ = done + timing_.silence;
+
+  std::uint8_t exception_code = 0;
+  const std::span registers{decoded_.data(), config.count};
+  switch (parse_read_response(response_, config.slave, config.function,
+                              registers, exception_code)) {
+  case ModbusResult::ok: {
+    {
+      std::lock_guard lock(registers_mutex_);
+      std::copy(registers.begin(), registers.end(), poll.registers.begin());
+    }
+    poll.responses.fetch_add(1, std::memory_order_relaxed);
+    const auto latency =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(done - sent)
+            .count();
+    poll.latency_sum_ns.fetch_add(latency, std::memory_order_relaxed);
+    if (latency > poll.latency_max_ns.load(std::memory_order_relaxed))
+      poll.latency_max_ns.store(latency, std::memory_order_relaxed);
+    break;
+  }
+  case ModbusResult::timeout:
+    poll.timeouts.fetch_add(1, std::memory_order_relaxed);
+    break;
+  case ModbusResult::bad_frame:
+    poll.bad_frames.fetch_add(1, std::memory_order_relaxed);
+    break;
+  case ModbusResult::exception:
+    poll.exceptions.fetch_add(1, std::memory_order_relaxed);
+    poll.last_exception.store(exception_code, std::memory_order_relaxed);
+    break;
+  case ModbusResult::mismatch:
+    poll.mismatches.fetch_add(1, std::memory_order_relaxed);
+    break;
+  }
+  return true;
+}
+
+bool ModbusPoller::receive(std::size_t expected, Clock::time_point timeout) {
+  response_.clear();
+  std::array<char, modbus_max_frame_size> buffer;
+  Clock::time_point first_byte;
+  Clock::time_point last_byte;
+  while (!stop_requested_.load(std::memory_order_relaxed)) {
+    std::size_t received = 0;
+    if (!port_->read({buffer.data(),
+                      modbus_max_frame_size - response_.size()},
+                     received)) {
+      error_ = port_->error();
+      return false;
+    }
+    const auto now = clock_->now();
+    if (received > 0) {
+      if (response_.empty())
+        first_byte = now;
+      response_.insert(response_.end(), buffer.begin(),
+                       buffer.begin() + received);
+      last_byte = now;
+    }
+
+    if (response_.empty()) {
+      if (now >= timeout)
+        return true;
+    } else if (response_.size() < 2) {
+      // Until the function code tells the length, silence ends the frame
+      if (now - last_byte >= timing_.end_of_frame)
+        return true;
+    } else {
+      // An exception response is 5 bytes whatever was asked. A gap inside
+      // a frame of known length, e.g. from a USB adapter's latency timer,
+      // doesn't end it, the response timeout past its wire time does.
+      const auto length = (response_[1] & 0x80) ? std::size_t{5} : expected;
+      if (response_.size() >= length ||
+          response_.size() == modbus_max_frame_size)
+        return true;
+      if (now >= first_byte + wire_time(length, line_limit_) +
+                     settings_.response_timeout)
+        return true;
+    }
+    clock_->sleep_until(now + timing_.character);
+  }
+  return true;
+}
+
+bool ModbusPoller::discard_input() {
+  std::array<char, modbus_max_frame_size> buffer;
+  std::size_t received = 0;
+  do {
+    if (!port_->read(buffer, received)) {
+      error_ = port_->error();
+      return false;
+    }
+    stray_bytes_.fetch_add(received, std::memory_order_relaxed);
+  } while (received > 0);
+  return true;
+}
+
+} // namespace excserial
@@ -0,0 +1,103 @@
+/**
+ * @file modbus_slave_port.cpp
+ * @brief Simulated Modbus RTU slaves to poll without a bus.
+ */
+
+#include "excserial/modbus_slave_port.h"
+
+#include "excserial/modbus.h"
+
+#include <algorithm>
+
+namespace excserial {
+
+namespace {
+
+constexpr unsigned char illegal_function = 0x01;
+constexpr unsigned char illegal_address = 0x02;
+
+} // namespace
+
+ModbusSlavePort::ModbusSlavePort(Clock &clock, const PortSettings &line)
+    : clock_(clock), character_(modbus_timing(line).character),
+      silence_(modbus_timing(line).silence), turnaround_(silence_) {
+  pending_.reserve(modbus_max_frame_size);
+}
+
+void ModbusSlavePort::add_slave(std::uint8_t address) {
+  present_[address] = true;
+}
+
+bool ModbusSlavePort::write(std::span<const char> data) {
+  const auto request_end =
+      clock_.now() + character_ * static_cast<std::int64_t>(data.size());
+  pending_.clear();
+  pending_read_ = 0;
+
+  const std::span bytes{reinterpret_cast<const unsigned char *>(data.data()),
+                        data.size()};
+  if (bytes.size() != modbus_request_size || modbus_crc(bytes) != 0 ||
+      !present_[bytes[0]])
+    return true;
+
+  const auto slave = bytes[0];
+  const auto function = bytes[1];
+  const auto address = static_cast<std::uint16_t>(bytes[2] << 8 | bytes[3]);
+  const auto count = static_cast<std::uint16_t>(bytes[4] << 8 | bytes[5]);
+  pending_.push_back(static_cast<char>(slave));
+  if (function != static_cast<unsigned char>(
+                      ModbusFunction::read_holding_registers) &&
+      function !=
+          static_cast<unsigned char>(ModbusFunction::read_input_registers)) {
+    pending_.push_back(static_cast<char>(function | 0x80));
+    pending_.push_back(static_cast<char>(illegal_function));
+  } else if (count == 0 || count > modbus_max_registers ||
+             std::uint32_t{address} + count > register_count) {
+    pending_.push_back(static_cast<char>(function | 0x80));
+    pending_.push_back(static_cast<char>(illegal_address));
+  } else {
+    const auto reads = reads_[slave]++;
+    pending_.push_back(static_cast<char>(function));
+    pending_.push_back(static_cast<char>(2 * count));
+    for (std::uint32_t i = 0; i < count; ++i) {
+      const auto value = static_cast<std::uint16_t>(address + i + reads);
+      pending_.push_back(static_cast<char>(value >> 8));
+      pending_.push_back(static_cast<char>(value));
+    }
+  }
+
+  auto crc = modbus_crc({reinterpret_cast<const unsigned char *>(
+                             pending_.data()),
+                         pending_.size()});
+  ++responses_;
+  if (corrupt_every_ != 0 && responses_ % corrupt_every_ == 0)
+    crc ^= 0x0001;
+  pending_.push_back(static_cast<char>(crc));
+  pending_.push_back(static_cast<char>(crc >> 8));
+  first_byte_ = request_end + std::max(turnaround_, silence_) + character_;
+  return true;
+}
+
+bool ModbusSlavePort::read(std::span<char> out, std::size_t &received) {
+  received = 0;
+  if (pending_read_ == pending_.size())
+    return true;
+  const auto now = clock_.now();
+  if (now < first_byte_)
+    return true;
+  // Bytes whose last bit has arrived, the ones after the gap later
+  const auto elapsed = now - first_byte_;
+  auto arrived = static_cast<std::size_t>(elapsed / character_) + 1;
+  if (gap_after_ != 0 && arrived > gap_after_) {
+    const auto after_gap = (elapsed - gap_) / character_ + 1;
+    arrived = std::max(gap_after_, static_cast<std::size_t>(
+                                       std::max<std::int64_t>(after_gap, 0)));
+  }
+  arrived = std::min(arrived, pending_.size());
+  received = std::min(arrived - pending_read_, out.size());
+  std::copy_n(pending_.begin() + pending_read_, received, out.begin());
+  pending_read_ += received;
+  return true;
+}
+
+} // namespace excserial
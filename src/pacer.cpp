@@ -0,0 +1,121 @@
+/**
+ * @file pacer.cpp
+ * @brief Fixed rate pacing of the send loop.
+ */
+
+#include "excserial/pacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace excserial {
+
+Period::Period(std::chrono::nanoseconds period)
+    : whole_(static_cast<std::uint64_t>(std::max<std::int64_t>(
+          period.count(), 0))) {
+}
+
+Period::Period(std::uint64_t numerator_ns, std::uint64_t denominator)
+    : whole_(numerator_ns / denominator),
+      remainder_(numerator_ns % denominator), divisor_(denominator) {
+  const auto common = std::gcd(remainder_, divisor_);
+  if (common > 1) {
+    remainder_ /= common;
+    divisor_ /= common;
+  }
+}
+
+Period Period::from_rate(double rate_hz) {
+  // Millihertz keep the divisor small enough for times() to stay in 64 bits
+  constexpr std::uint64_t ns_per_ks = 1'000'000'000'000;
+  const auto millihertz = std::clamp<long long>(
+      std::llround(rate_hz * 1e3), 1, 1'000'000'000);
+  return {ns_per_ks, static_cast<std::uint64_t>(millihertz)};
+}
+
+std::chrono::nanoseconds Period::times(std::uint64_t ticks) const {
+  // ticks * remainder / divisor without overflowing, the product in the last
+  // term is below divisor squared
+  const auto fraction = ticks / divisor_ * remainder_ +
+                        ticks % divisor_ * remainder_ / divisor_;
+  return std::chrono::nanoseconds{
+      static_cast<std::int64_t>(ticks * whole_ + fraction)};
+}
+
+std::chrono::nanoseconds Period::rounded() const {
+  const auto round_up = 2 * remainder_ >= divisor_ ? 1 : 0;
+  return std::chrono::nanoseconds{
+      static_cast<std::int64_t>(whole_ + round_up)};
+}
+
+PeriodAccumulator::PeriodAccumulator(const Period &period)
+    : period_(period) {
+}
+
+void PeriodAccumulator::advance() {
+  elapsed_ += std::chrono::nanoseconds{
+      static_cast<std::int64_t>(period_.whole_)};
+  fraction_ += period_.remainder_;
+  if (fraction_ >= period_.divisor_) {
+    fraction_ -= period_.divisor_;
+    ++elapsed_;
+  }
+}
+
+void PeriodAccumulator::advance(std::uint64_t ticks) {
+  const auto divisor = period_.divisor_;
+  const auto carry = fraction_ + ticks % divisor * period_.remainder_;
+  elapsed_ += std::chrono::nanoseconds{static_cast<std::int64_t>(
+      ticks * period_.whole_ + ticks / divisor * period_.remainder_ +
+      carry / divisor)};
+  fraction_ = carry % divisor;
+}
+
+std::uint64_t
+PeriodAccumulator::advance_past(std::chrono::nanoseconds offset) {
+  advance();
+  if (elapsed_ > offset)
+    return 1;
+
+  // Behind by more than a period, jump by a lower bound of the ticks needed
+  // and step the rest
+  std::uint64_t ticks = 1;
+  const auto longest = static_cast<std::int64_t>(
+      period_.whole_ + (period_.remainder_ > 0 ? 1 : 0));
+  const auto jump =
+      static_cast<std::uint64_t>((offset - elapsed_).count() / longest);
+  if (jump > 0) {
+    advance(jump);
+    ticks += jump;
+  }
+  while (elapsed_ <= offset) {
+    advance();
+    ++ticks;
+  }
+  return ticks;
+}
+
+Pacer::Pacer(Period period, Clock &clock) : period_(period), clock_(clock) {
+  reset(clock_.now());
+}
+
+void Pacer::reset(time_point start) {
+  start_ = start;
+  ticks_ = PeriodAccumulator{period_};
+  ticks_.advance();
+  next_ = start_ + ticks_.elapsed();
+}
+
+Pacer::time_point Pacer::wait() {
+  clock_.sleep_until(next_);
+  const auto now = clock_.now();
+  deadline_ = next_;
+
+  // More than a period behind, skip the missed ticks instead of bursting
+  ticks_.advance_past(now - start_);
+  next_ = start_ + ticks_.elapsed();
+  return now;
+}
+
+} // namespace excserial
@@ -0,0 +1,166 @@
+/**
+ * @file placement.cpp
+ * @brief Core and NUMA node placement of send threads.
+ */
+
+#include "excserial/placement.h"
+
+#include <format>
+#include <windows.h>
+
+// initguid.h first so the device keys and class GUIDs are defined here
+#include <initguid.h>
+
+#include <cfgmgr32.h>
+#include <devguid.h>
+#include <devpkey.h>
+#include <setupapi.h>
+
+namespace excserial {
+
+namespace {
+
+/// Group and number of a processor counted across all groups.
+bool processor_number(int cpu, PROCESSOR_NUMBER &number) {
+  const WORD groups = GetActiveProcessorGroupCount();
+  for (WORD group = 0; group < groups; ++group) {
+    const auto count = static_cast<int>(GetActiveProcessorCount(group));
+    if (cpu < count) {
+      number = {};
+      number.Group = group;
+      number.Number = static_cast<BYTE>(cpu);
+      return true;
+    }
+    cpu -= count;
+  }
+  return false;
+}
+
+/// Walks from a device up to the root for the first reported NUMA node.
+int device_numa_node(DEVINST device) {
+  while (true) {
+    DEVPROPTYPE type = 0;
+    ULONG node = 0;
+    ULONG size = sizeof(node);
+    if (CM_Get_DevNode_PropertyW(device, &DEVPKEY_Device_Numa_Node, &type,
+                                 reinterpret_cast<PBYTE>(&node), &size,
+                                 0) == CR_SUCCESS &&
+        type == DEVPROP_TYPE_UINT32)
+      return static_cast<int>(node);
+    DEVINST parent = 0;
+    if (CM_Get_Parent(&parent, device, 0) != CR_SUCCESS)
+      return -1;
+    device = parent;
+  }
+}
+
+} // namespace
+
+int numa_node_count() {
+  ULONG highest = 0;
+  if (!GetNumaHighestNodeNumber(&highest))
+    return 1;
+  return static_cast<int>(highest) + 1;
+}
+
+int port_numa_node(std::string_view port) {
+  if (port.starts_with("\\\\.\\"))
+    port.remove_prefix(4);
+
+  HDEVINFO devices = SetupDiGetClassDevsW(&GUID_DEVCLASS_PORTS, nullptr,
+                                          nullptr, DIGCF_PRESENT);
+  if (devices == INVALID_HANDLE_VALUE)
+    return -1;
+  int node = -1;
+  SP_DEVINFO_DATA device{};
+  device.cbSize = sizeof(device);
+  for (DWORD i = 0; SetupDiEnumDeviceInfo(devices, i, &device); ++i) {
+    // The COM name lives in the device's hardware key
+    HKEY key = SetupDiOpenDevRegKey(devices, &device, DICS_FLAG_GLOBAL, 0,
+                                    DIREG_DEV, KEY_READ);
+    if (key == INVALID_HANDLE_VALUE)
+      continue;
+    char name[32] = {};
+    DWORD size = sizeof(name) - 1;
+    DWORD type = 0;
+    const bool named =
+        RegQueryValueExA(key, "PortName", nullptr, &type,
+                         reinterpret_cast<LPBYTE>(name),
+                         &size) == ERROR_SUCCESS &&
+        type == REG_SZ;
+    RegCloseKey(key);
+    if (named && lstrcmpiA(name, std::string(port).c_str()) == 0) {
+      node = device_numa_node(device.DevInst);
+      break;
+    }
+  }
+  SetupDiDestroyDeviceInfoList(devices);
+  return node;
+}
+
+bool resolve_placement(const Placement &placement, std::string_view port,
+                       PlacementInfo &info, std::string &error) {
+  info = {};
+  if (!placement.requested())
+    return true;
+  info.port_node = port_numa_node(port);
+
+  if (placement.cpu >= 0) {
+    PROCESSOR_NUMBER number;
+    USHORT node = 0;
+    if (!processor_number(placement.cpu, number)) {
+      error = std::format("No processor {}", placement.cpu);
+      return false;
+    }
+    info.cpu = placement.cpu;
+    info.group = number.Group;
+    info.mask = std::uint64_t{1} << number.Number;
+    if (GetNumaProcessorNodeEx(&number, &node))
+      info.thread_node = node;
+    return true;
+  }
+
+  int node = placement.numa_node;
+  if (node < 0) {
+    // Near the port, or nothing to bind to if it reports no node
+    if (info.port_node < 0)
+      return true;
+    node = info.port_node;
+  }
+  GROUP_AFFINITY affinity{};
+  if (node >= numa_node_count() ||
+      !GetNumaNodeProcessorMaskEx(static_cast<USHORT>(node), &affinity) ||
+      affinity.Mask == 0) {
+    error = std::format("No NUMA node {}", node);
+    return false;
+  }
+  info.thread_node = node;
+  info.group = affinity.Group;
+  info.mask = affinity.Mask;
+  return true;
+}
+
+bool bind_current_thread(const PlacementInfo &info) {
+  if (info.mask == 0)
+    return true;
+  GROUP_AFFINITY affinity{};
+  affinity.Group = info.group;
+  affinity.Mask = static_cast<KAFFINITY>(info.mask);
+  return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+}
+
+void *allocate_on_node(std::size_t size, int node) {
+  if (node < 0)
+    return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT,
+                        PAGE_READWRITE);
+  return VirtualAllocExNuma(GetCurrentProcess(), nullptr, size,
+                            MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE,
+                            static_cast<DWORD>(node));
+}
+
+void free_on_node(void *memory) {
+  if (memory != nullptr)
+    VirtualFree(memory, 0, MEM_RELEASE);
+}
+
+} // namespace excserial
@@ -0,0 +1,62 @@
+/**
+ * @file reporter.cpp
+ * @brief Status line printing off the timing critical threads.
+ */
+
+#include "excserial/reporter.h"
+
+#include <cstring>
+#include <windows.h>
+
+namespace excserial {
+
+StatusReporter::~StatusReporter() {
+  stop();
+}
+
+void StatusReporter::start(Render render, std::chrono::milliseconds interval) {
+  stop();
+  render_ = std::move(render);
+  interval_ = interval;
+  stop_requested_ = false;
+  thread_ = std::thread(&StatusReporter::run, this);
+}
+
+void StatusReporter::stop() {
+  {
+    std::lock_guard lock(mutex_);
+    stop_requested_ = true;
+  }
+  wake_.notify_one();
+  if (thread_.joinable())
+    thread_.join();
+}
+
+void StatusReporter::run() {
+  // Lose to the send thread and everything else on a busy core
+  SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+  HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+
+  StatusLine line;
+  // Carriage return, the line, and blanks over what is left of the last one
+  std::array<char, 1 + 2 * StatusLine::capacity> output;
+  std::size_t last_size = 0;
+
+  std::unique_lock lock(mutex_);
+  while (!wake_.wait_for(lock, interval_, [this] { return stop_requested_; })) {
+    line.clear();
+    render_(line);
+    const auto text = line.view();
+    output[0] = '\r';
+    std::memcpy(output.data() + 1, text.data(), text.size());
+    const auto blanks = last_size > text.size() ? last_size - text.size() : 0;
+    std::memset(output.data() + 1 + text.size(), ' ', blanks);
+    last_size = text.size();
+
+    DWORD written = 0;
+    WriteFile(console, output.data(),
+              static_cast<DWORD>(1 + text.size() + blanks), &written, nullptr);
+  }
+}
+
+} // namespace excserial
@@ -0,0 +1,260 @@
+/**
+ * @file scheduler.cpp
+ * @brief Several periodic streams at different rates on one thread.
+ */
+
+#include "excserial/scheduler.h"
+
+#include "excserial/error.h"
+#include "excserial/timer_wheel.h"
+
+#include <format>
+
+namespace excserial {
+
+MultiRateScheduler::~MultiRateScheduler() {
+  stop();
+}
+
+std::size_t MultiRateScheduler::add_port(Port &port) {
+  ports_.emplace_back().port = &port;
+  return ports_.size() - 1;
+}
+
+std::size_t MultiRateScheduler::add_stream(const ScheduledStream &stream) {
+  auto &state = streams_.emplace_back();
+  state.config = stream;
+  state.values.store(stream.values);
+  return streams_.size() - 1;
+}
+
+void MultiRateScheduler::update_values(std::size_t stream,
+                                       const Values &values) {
+  std::lock_guard lock(update_mutex_); // ValueSlot allows one writer
+  streams_[stream].values.store(values);
+}
+
+bool MultiRateScheduler::start(std::uint64_t tick_limit) {
+  stop();
+  if (streams_.empty()) {
+    error_ = "No streams to schedule";
+    return false;
+  }
+  for (const auto &stream : streams_) {
+    if (stream.config.port >= ports_.size()) {
+      error_ = "Stream refers to a port that was not added";
+      return false;
+    }
+    if (!stream.config.period.positive()) {
+      error_ = "Stream period must be positive";
+      return false;
+    }
+  }
+  if (pooled_ && format_ == FrameFormat::delta) {
+    error_ = "The writer pool drops frames, delta frames can't be dropped";
+    return false;
+  }
+
+  if (!resolve_placement(placement_request_, ports_.front().port->name(),
+                         placement_, error_))
+    return false;
+
+  // Deadlines, timer wheel state, due lists and some alignment slack
+  const auto streams = streams_.size();
+  arena_.reset(streams * (sizeof(PeriodAccumulator) + sizeof(std::uint64_t) +
+                          2 * sizeof(std::uint32_t)) +
+                   ports_.size() * sizeof(std::size_t) + 4096,
+               placement_.thread_node);
+
+  error_.clear();
+  writes_ = 0;
+  heap_allocations_ = 0;
+  telemetry_requested_ = false;
+  for (auto &port : ports_) {
+    port.encoder = FrameEncoder{format_};
+    port.frames = 0;
+    port.bytes = 0;
+    port.lateness.reset();
+    port.queued_bytes = 0;
+  }
+  pool_.reset();
+  if (pooled_) {
+    std::vector<Port *> ports;
+    for (const auto &port : ports_)
+      ports.push_back(port.port);
+    pool_ = std::make_unique<WriterPool>(ports, pool_threads_);
+  }
+  for (auto &stream : streams_) {
+    stream.sign = 1;
+    stream.ticks = 0;
+    stream.missed = 0;
+    stream.lateness_sum_ns = 0;
+    stream.lateness_max_ns = 0;
+  }
+  stop_requested_ = false;
+  running_ = true;
+  thread_ = std::thread(&MultiRateScheduler::run, this, tick_limit);
+  return true;
+}
+
+void MultiRateScheduler::stop() {
+  stop_requested_ = true;
+  if (thread_.joinable())
+    thread_.join();
+  if (pool_)
+    pool_->stop();
+}
+
+std::vector<StreamLateness> MultiRateScheduler::lateness() const {
+  std::vector<StreamLateness> result;
+  result.reserve(streams_.size());
+  for (std::size_t i = 0; i < streams_.size(); ++i)
+    result.push_back(lateness(i));
+  return result;
+}
+
+StreamLateness MultiRateScheduler::lateness(std::size_t index) const {
+  const auto &stream = streams_[index];
+  StreamLateness lateness;
+  lateness.ticks = stream.ticks.load(std::memory_order_relaxed);
+  lateness.missed = stream.missed.load(std::memory_order_relaxed);
+  if (lateness.ticks > 0) {
+    lateness.mean_us = static_cast<double>(stream.lateness_sum_ns.load(
+                           std::memory_order_relaxed)) /
+                       1e3 / static_cast<double>(lateness.ticks);
+  }
+  lateness.max_us =
+      static_cast<double>(
+          stream.lateness_max_ns.load(std::memory_order_relaxed)) /
+      1e3;
+  return lateness;
+}
+
+PortCounters MultiRateScheduler::port_counters(std::size_t index) const {
+  const auto &port = ports_[index];
+  return {port.frames.load(std::memory_order_relaxed),
+          port.bytes.load(std::memory_order_relaxed)};
+}
+
+void MultiRateScheduler::run(std::uint64_t tick_limit) {
+  if (!bind_current_thread(placement_)) {
+    error_ = std::format("Could not bind the scheduler thread: {}",
+                         error_string(GetLastError()));
+    running_.store(false, std::memory_order_release);
+    return;
+  }
+
+  using std::chrono::microseconds;
+  // The wheel counts whole microseconds from start, rounded up so a stream
+  // is never served before its exact deadline
+  const auto start = clock_->now();
+  const auto to_tick = [start](Clock::time_point deadline) {
+    const auto us = std::chrono::ceil<microseconds>(deadline - start);
+    return static_cast<std::uint64_t>(us.count());
+  };
+
+  // Everything the loop touches comes from the arena sized in start()
+  auto *memory = arena_.resource();
+  // Deadlines are offsets from start summed exactly, so a 300 Hz stream
+  // doesn't drift by the fraction of a nanosecond in its period
+  std::pmr::vector<PeriodAccumulator> offsets(memory);
+  offsets.reserve(streams_.size());
+  TimerWheel wheel(streams_.size(), memory);
+  for (std::size_t i = 0; i < streams_.size(); ++i) {
+    auto &offset = offsets.emplace_back(streams_[i].config.period);
+    offset.advance();
+    wheel.schedule(static_cast<std::uint32_t>(i),
+                   to_tick(start + offset.elapsed()));
+  }
+
+  std::pmr::vector<std::uint32_t> due_streams(memory);
+  due_streams.reserve(streams_.size());
+  std::pmr::vector<std::size_t> due_ports(memory);
+  due_ports.reserve(ports_.size());
+  FrameBuffer frame;
+  std::uint64_t ticks = 0;
+
+  // Setup above may allocate, the loop must not
+  const auto allocations_before = thread_heap_allocations();
+  while (!stop_requested_.load(std::memory_order_relaxed) &&
+         (tick_limit == 0 || ticks < tick_limit)) {
+    const auto tick = *wheel.next_expiry();
+    clock_->sleep_until(start + microseconds(tick));
+    const auto now = clock_->now();
+    due_streams.clear();
+    wheel.advance(tick, due_streams);
+
+    // Serve every stream due on this tick, merging per port
+    for (const auto index : due_streams) {
+      if (tick_limit != 0 && ticks >= tick_limit)
+        break;
+      auto &stream = streams_[index];
+      auto &offset = offsets[index];
+
+      const auto late = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            now - (start + offset.elapsed()))
+                            .count();
+      stream.lateness_sum_ns.fetch_add(late, std::memory_order_relaxed);
+      if (late > stream.lateness_max_ns.load(std::memory_order_relaxed))
+        stream.lateness_max_ns.store(late, std::memory_order_relaxed);
+      stream.ticks.fetch_add(1, std::memory_order_relaxed);
+      ++ticks;
+
+      auto &port = ports_[stream.config.port];
+      port.lateness.add(std::chrono::nanoseconds(late));
+      const auto values = stream.values.load();
+      for (std::size_t channel = 0; channel < channel_count; ++channel) {
+        if (stream.config.channels & (1u << channel))
+          port.values[channel] = values[channel] * stream.sign;
+      }
+      if (stream.config.alternate)
+        stream.sign = -stream.sign;
+      if (!port.due) {
+        port.due = true;
+        due_ports.push_back(stream.config.port);
+      }
+
+      // Reschedule, skipping ticks that are already in the past
+      const auto behind = offset.advance_past(now - start) - 1;
+      if (behind > 0)
+        stream.missed.fetch_add(behind, std::memory_order_relaxed);
+      wheel.schedule(index, to_tick(start + offset.elapsed()));
+    }
+
+    for (const auto index : due_ports) {
+      auto &port = ports_[index];
+      port.due = false;
+      const auto size = port.encoder.encode(port.values, frame);
+      if (pool_) {
+        pool_->submit(index, {frame.data(), size});
+      } else if (port.port->write({frame.data(), size})) {
+        writes_.fetch_add(1, std::memory_order_relaxed);
+      } else {
+        error_ = port.port->error();
+        stop_requested_ = true;
+        break;
+      }
+      port.frames.fetch_add(1, std::memory_order_relaxed);
+      port.bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+    due_ports.clear();
+    if (telemetry_requested_.load(std::memory_order_relaxed)) {
+      telemetry_requested_.store(false, std::memory_order_relaxed);
+      for (auto &port : ports_) {
+        port.sent_values.store(port.values);
+        port.queued_bytes.store(port.port->queued_bytes(),
+                                std::memory_order_relaxed);
+      }
+    }
+    if (pool_ && pool_->failed()) {
+      error_ = pool_->error();
+      stop_requested_ = true;
+    }
+  }
+
+  heap_allocations_.store(thread_heap_allocations() - allocations_before,
+                          std::memory_order_relaxed);
+  running_.store(false, std::memory_order_release);
+}
+
+} // namespace excserial
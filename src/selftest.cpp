@@ -0,0 +1,305 @@
+/**
+ * @file selftest.cpp
+ * @brief Host qualification: can this PC hold a given rate and jitter?
+ */
+
+#include "excserial/selftest.h"
+
+#include "excserial/error.h"
+#include "excserial/frame.h"
+#include "excserial/link_budget.h"
+#include "excserial/serial_port.h"
+#include "excserial_delta.h"
+
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <windows.h>
+
+namespace excserial {
+
+namespace {
+
+using steady = std::chrono::steady_clock;
+
+std::int64_t elapsed_ns(steady::time_point from, steady::time_point to) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(to - from)
+      .count();
+}
+
+bool uses_spin(PacingMode mode) {
+  return mode == PacingMode::spin || mode == PacingMode::hybrid ||
+         mode == PacingMode::adaptive;
+}
+
+WakeResult measure_wake(PacingMode mode, SpinMode spin,
+                        const SelftestOptions &options) {
+  SteadyClock clock{mode};
+  clock.set_spin_mode(spin);
+  std::vector<std::int64_t> lateness;
+  lateness.reserve(static_cast<std::size_t>(options.wake_samples));
+
+  const auto cpu_start = thread_cpu_times();
+  const auto wall_start = steady::now();
+  auto deadline = wall_start;
+  for (int i = 0; i < options.wake_samples; ++i) {
+    deadline += options.wake_period;
+    clock.sleep_until(deadline);
+    const auto woke = steady::now();
+    lateness.push_back(elapsed_ns(deadline, woke));
+    // Don't let one long oversleep turn into a burst of zero waits
+    if (woke > deadline)
+      deadline = woke;
+  }
+  const auto cpu_end = thread_cpu_times();
+  const std::chrono::duration<double> wall = steady::now() - wall_start;
+  const std::chrono::duration<double> user = cpu_end.user - cpu_start.user;
+  const std::chrono::duration<double> kernel =
+      cpu_end.kernel - cpu_start.kernel;
+
+  WakeResult result{mode, spin, summarize(lateness)};
+  result.cpu_fraction = (user + kernel) / wall;
+  result.kernel_fraction = kernel / wall;
+  result.spin_turns_per_ms =
+      static_cast<double>(clock.spin_turns()) / (wall.count() * 1e3);
+  return result;
+}
+
+double measure_clock_read_ns() {
+  constexpr int reads = 1'000'000;
+  const auto start = steady::now();
+  steady::time_point last;
+  for (int i = 0; i < reads; ++i)
+    last = steady::now();
+  return static_cast<double>(elapsed_ns(start, last)) / reads;
+}
+
+double measure_encode_ns() {
+  constexpr int frames = 1'000'000;
+  FrameBuffer frame;
+  std::size_t total = 0; // Keeps the loop from being optimized out
+  const auto start = steady::now();
+  for (int i = 0; i < frames; ++i) {
+    const Values values{i, -i, i * 7, -i * 7};
+    total += encode_text_frame(values, frame);
+  }
+  const auto end = steady::now();
+  return total == 0 ? 0.0
+                    : static_cast<double>(elapsed_ns(start, end)) / frames;
+}
+
+FormatCost measure_format(FrameFormat format) {
+  // One second of a 1 Hz sine of amplitude 1000 sent at 1 kHz, the channels
+  // a quarter period apart
+  constexpr std::size_t rows = 1000;
+  constexpr double two_pi = 6.283185307179586;
+  std::vector<Values> table(rows);
+  for (std::size_t row = 0; row < rows; ++row) {
+    for (std::size_t channel = 0; channel < channel_count; ++channel) {
+      const double phase = static_cast<double>(row) / rows +
+                           static_cast<double>(channel) / channel_count;
+      table[row][channel] = static_cast<std::int32_t>(
+          std::lround(1000.0 * std::sin(two_pi * phase)));
+    }
+  }
+
+  constexpr std::size_t frames = 1'000'000;
+  FrameEncoder encoder{format};
+  FrameBuffer frame;
+  std::size_t total = 0;
+  const auto start = steady::now();
+  for (std::size_t i = 0; i < frames; ++i)
+    total += encoder.encode(table[i % rows], frame);
+  const auto end = steady::now();
+
+  FormatCost cost{format};
+  cost.encode_ns = static_cast<double>(elapsed_ns(start, end)) / frames;
+  cost.bytes_per_frame = static_cast<double>(total) / frames;
+  cost.max_rate_hz = line_limit(PortSettings{}) / cost.bytes_per_frame;
+  if (format != FrameFormat::delta)
+    return cost;
+
+  // Decode the same stream byte by byte, as firmware would
+  std::vector<std::uint8_t> stream;
+  stream.reserve(total);
+  encoder.reset();
+  for (std::size_t i = 0; i < frames; ++i) {
+    const auto size = encoder.encode(table[i % rows], frame);
+    stream.insert(stream.end(), frame.begin(), frame.begin() + size);
+  }
+  excserial_delta_decoder decoder;
+  excserial_delta_init(&decoder);
+  std::int32_t values[EXCSERIAL_DELTA_CHANNELS];
+  const auto decode_start = steady::now();
+  for (const auto byte : stream)
+    excserial_delta_feed(&decoder, byte, values);
+  const auto decode_end = steady::now();
+  cost.decode_ns =
+      decoder.frames == 0
+          ? 0.0
+          : static_cast<double>(elapsed_ns(decode_start, decode_end)) /
+                decoder.frames;
+  return cost;
+}
+
+void measure_write(const SelftestOptions &options, SelftestReport &report) {
+  FrameBuffer frame;
+  const auto size = encode_text_frame({-1000, -1000, -1000, -1000}, frame);
+  const std::span<const char> data{frame.data(), size};
+  std::vector<std::int64_t> samples;
+  samples.reserve(static_cast<std::size_t>(options.write_samples));
+
+  if (!options.port.empty()) {
+    report.write_target = options.port;
+    SerialPort port;
+    if (!port.open(options.port)) {
+      report.error = port.error();
+      return;
+    }
+    for (int i = 0; i < options.write_samples; ++i) {
+      const auto start = steady::now();
+      if (!port.write(data)) {
+        report.error = port.error();
+        return;
+      }
+      samples.push_back(elapsed_ns(start, steady::now()));
+    }
+  } else {
+    // Syscall and I/O manager cost without a driver behind it
+    report.write_target = "NUL";
+    HANDLE nul = CreateFileA("NUL", GENERIC_WRITE, 0, nullptr, OPEN_EXISTING,
+                             0, nullptr);
+    if (nul == INVALID_HANDLE_VALUE) {
+      report.error = std::format("Could not open NUL: {}",
+                                 error_string(GetLastError()));
+      return;
+    }
+    for (int i = 0; i < options.write_samples; ++i) {
+      DWORD written = 0;
+      const auto start = steady::now();
+      WriteFile(nul, data.data(), static_cast<DWORD>(data.size()), &written,
+                nullptr);
+      samples.push_back(elapsed_ns(start, steady::now()));
+    }
+    CloseHandle(nul);
+  }
+  report.write = summarize(samples);
+}
+
+} // namespace
+
+LatencySummary summarize(std::vector<std::int64_t> &samples_ns) {
+  LatencySummary summary;
+  if (samples_ns.empty())
+    return summary;
+  std::sort(samples_ns.begin(), samples_ns.end());
+  const auto at = [&samples_ns](double quantile) {
+    const auto index = static_cast<std::size_t>(
+        quantile * static_cast<double>(samples_ns.size() - 1));
+    return static_cast<double>(samples_ns[index]) / 1e3;
+  };
+  summary.min_us = at(0.0);
+  summary.p50_us = at(0.5);
+  summary.p99_us = at(0.99);
+  summary.max_us = at(1.0);
+  return summary;
+}
+
+CpuTimes thread_cpu_times() {
+  FILETIME creation, exit, kernel, user;
+  if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+    return {};
+  // FILETIME counts 100 ns intervals
+  const auto ns = [](const FILETIME &time) {
+    return std::chrono::nanoseconds{
+        ((static_cast<std::int64_t>(time.dwHighDateTime) << 32) |
+         time.dwLowDateTime) *
+        100};
+  };
+  return {ns(user), ns(kernel)};
+}
+
+SelftestReport run_selftest(const SelftestOptions &options) {
+  SelftestReport report;
+  report.clock_read_ns = measure_clock_read_ns();
+  report.encode_ns = measure_encode_ns();
+  for (const auto mode : pacing_modes) {
+    if (!uses_spin(mode)) {
+      report.wake.push_back(measure_wake(mode, SpinMode::yield, options));
+      continue;
+    }
+    for (const auto spin : spin_modes) {
+      // Without WAITPKG tpause would just repeat the pause numbers
+      if (spin == SpinMode::tpause && !tpause_supported())
+        continue;
+      report.wake.push_back(measure_wake(mode, spin, options));
+    }
+  }
+  for (const auto format : frame_formats)
+    report.formats.push_back(measure_format(format));
+  measure_write(options, report);
+  return report;
+}
+
+void print_report(const SelftestReport &report,
+                  const SelftestOptions &options, std::ostream &out) {
+  const double budget_us =
+      std::chrono::duration<double, std::micro>(options.jitter_budget).count();
+
+  out << std::format("Clock read:   {:.1f} ns\n", report.clock_read_ns);
+  out << std::format("Frame encode: {:.1f} ns\n", report.encode_ns);
+  for (const auto &cost : report.formats) {
+    out << std::format("Format {:<6} on a slow sine: {:.1f} bytes, encode "
+                       "{:.1f} ns",
+                       to_string(cost.format), cost.bytes_per_frame,
+                       cost.encode_ns);
+    if (cost.decode_ns > 0.0)
+      out << std::format(", decode {:.1f} ns", cost.decode_ns);
+    out << std::format(", up to {:.0f} Hz at 115200 baud\n",
+                       cost.max_rate_hz);
+  }
+  if (report.error.empty()) {
+    out << std::format("Write to {}: p50 {:.1f} us, p99 {:.1f} us, "
+                       "max {:.1f} us\n",
+                       report.write_target, report.write.p50_us,
+                       report.write.p99_us, report.write.max_us);
+  } else {
+    out << std::format("Write to {} failed: {}\n", report.write_target,
+                       report.error);
+  }
+
+  out << std::format("\nWake-up lateness, {} samples at {:.0f} us period, "
+                     "budget {:.0f} us (p99)\n",
+                     options.wake_samples,
+                     std::chrono::duration<double, std::micro>(
+                         options.wake_period)
+                         .count(),
+                     budget_us);
+  out << std::format("TPAUSE: {}\n", tpause_supported() ? "supported"
+                                                        : "not supported");
+  out << "mode              p50 us    p99 us    max us   cpu  kernel  "
+         "turns/ms  max rate\n";
+  for (const auto &wake : report.wake) {
+    // A frame costs its wake-up lateness, two clock reads, encoding and the
+    // write, all of which must fit in one period
+    std::string max_rate = "over budget";
+    if (wake.lateness.p99_us <= budget_us) {
+      const double service_us = wake.lateness.p99_us +
+                                2.0 * report.clock_read_ns / 1e3 +
+                                report.encode_ns / 1e3 + report.write.p99_us;
+      max_rate = std::format("{:.0f} Hz", 1e6 / std::max(service_us, 1e-3));
+    }
+    const auto name =
+        uses_spin(wake.mode)
+            ? std::format("{}/{}", to_string(wake.mode), to_string(wake.spin))
+            : std::string(to_string(wake.mode));
+    out << std::format("{:<15} {:>8.1f}  {:>8.1f}  {:>8.1f}  {:>3.0f}%  "
+                       "{:>5.0f}%  {:>8.0f}  {}\n",
+                       name, wake.lateness.p50_us, wake.lateness.p99_us,
+                       wake.lateness.max_us, wake.cpu_fraction * 100.0,
+                       wake.kernel_fraction * 100.0, wake.spin_turns_per_ms,
+                       max_rate);
+  }
+}
+
+} // namespace excserial
@@ -0,0 +1,151 @@
+/**
+ * @file serial_port.cpp
+ * @brief Windows COM port handling.
+ */
+
+#include "excserial/serial_port.h"
+
+#include "excserial/error.h"
+
+#include <format>
+#include <utility>
+
+namespace excserial {
+
+SerialPort::~SerialPort() {
+  close();
+}
+
+SerialPort::SerialPort(SerialPort &&other) noexcept
+    : handle_(std::exchange(other.handle_, INVALID_HANDLE_VALUE)),
+      name_(std::move(other.name_)), settings_(other.settings_),
+      error_(std::move(other.error_)) {
+}
+
+SerialPort &SerialPort::operator=(SerialPort &&other) noexcept {
+  if (this != &other) {
+    close();
+    handle_ = std::exchange(other.handle_, INVALID_HANDLE_VALUE);
+    name_ = std::move(other.name_);
+    settings_ = other.settings_;
+    error_ = std::move(other.error_);
+  }
+  return *this;
+}
+
+bool SerialPort::open(std::string_view name, const PortSettings &settings) {
+  close();
+  name_ = name;
+  settings_ = settings;
+
+  handle_ = CreateFileA(name_.c_str(), GENERIC_READ | GENERIC_WRITE, 0,
+                        nullptr, OPEN_EXISTING, 0, nullptr);
+  if (handle_ == INVALID_HANDLE_VALUE) {
+    error_ = std::format("CreateFile failed with error: {}",
+                         error_string(GetLastError()));
+    return false;
+  }
+
+  // Initialize DCB structure for com port
+  DCB dcb;
+  SecureZeroMemory(&dcb, sizeof(DCB));
+  dcb.DCBlength = sizeof(DCB);
+
+  // Get current settings
+  if (!GetCommState(handle_, &dcb)) {
+    error_ = std::format("GetCommState failed with error: {}",
+                         error_string(GetLastError()));
+    close();
+    return false;
+  }
+
+  // Set settings
+  dcb.BaudRate = settings.baud_rate;
+  dcb.ByteSize = settings.byte_size;
+  dcb.Parity = settings.parity;
+  dcb.StopBits = settings.stop_bits;
+  if (settings.rts_toggle)
+    dcb.fRtsControl = RTS_CONTROL_TOGGLE;
+  if (!SetCommState(handle_, &dcb)) {
+    error_ = std::format("SetCommState failed with error: {}",
+                         error_string(GetLastError()));
+    close();
+    return false;
+  }
+
+  // Without this timeout is infinite. Reads return at once with what has
+  // arrived, pollers wait on their own clock.
+  COMMTIMEOUTS timeouts = {0};
+  timeouts.ReadIntervalTimeout = MAXDWORD;
+  timeouts.ReadTotalTimeoutConstant = 0;
+  timeouts.ReadTotalTimeoutMultiplier = 0;
+  timeouts.WriteTotalTimeoutConstant = 50;
+  timeouts.WriteTotalTimeoutMultiplier = 10;
+  if (!SetCommTimeouts(handle_, &timeouts)) {
+    error_ = std::format("Could not set timeouts with error: {}",
+                         error_string(GetLastError()));
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+bool SerialPort::write(std::span<const char> data) {
+  DWORD bytes_written = 0;
+  if (!WriteFile(handle_, data.data(), static_cast<DWORD>(data.size()),
+                 &bytes_written, nullptr)) {
+    error_ = std::format("Failed to write to {} with error: {}", name_,
+                         error_string(GetLastError()));
+    return false;
+  }
+  if (bytes_written != data.size()) {
+    error_ = std::format("Write to {} timed out after {} of {} bytes", name_,
+                         bytes_written, data.size());
+    return false;
+  }
+  return true;
+}
+
+bool SerialPort::read(std::span<char> out, std::size_t &received) {
+  DWORD bytes_read = 0;
+  received = 0;
+  if (!ReadFile(handle_, out.data(), static_cast<DWORD>(out.size()),
+                &bytes_read, nullptr)) {
+    error_ = std::format("Failed to read from {} with error: {}", name_,
+                         error_string(GetLastError()));
+    return false;
+  }
+  received = bytes_read;
+  return true;
+}
+
+std::size_t SerialPort::queued_bytes() {
+  DWORD errors = 0;
+  COMSTAT status{};
+  if (!ClearCommError(handle_, &errors, &status))
+    return 0;
+  return status.cbOutQue;
+}
+
+bool SerialPort::set_rts(bool on) {
+  // Would fight RTS_CONTROL_TOGGLE, which raises it only while sending
+  if (settings_.rts_toggle)
+    return true;
+  if (!EscapeCommFunction(handle_, on ? SETRTS : CLRRTS)) {
+    error_ = std::format("Could not {} RTS on {} with error: {}",
+                         on ? "raise" : "drop", name_,
+                         error_string(GetLastError()));
+    return false;
+  }
+  return true;
+}
+
+void SerialPort::close() {
+  if (handle_ != INVALID_HANDLE_VALUE) {
+    CloseHandle(handle_);
+    handle_ = INVALID_HANDLE_VALUE;
+  }
+}
+
+} // namespace excserial
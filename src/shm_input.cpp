@@ -0,0 +1,64 @@
+/**
+ * @file shm_input.cpp
+ * @brief Consumer side of the shared memory value block.
+ */
+
+#include "excserial/shm_input.h"
+
+#include "excserial/error.h"
+
+#include <algorithm>
+#include <atomic>
+#include <format>
+
+namespace excserial {
+
+ShmInput::~ShmInput() {
+  close();
+}
+
+bool ShmInput::open(std::string_view name) {
+  close();
+  block_ = excserial_shm_open(std::string(name).c_str(), &mapping_);
+  if (block_ == nullptr) {
+    error_ = std::format("Could not open shared memory {}: {}", name,
+                         error_string(GetLastError()));
+    return false;
+  }
+  if (block_->magic != EXCSERIAL_SHM_MAGIC ||
+      block_->version != EXCSERIAL_SHM_VERSION) {
+    error_ = std::format("Shared memory {} has an unknown layout, or its "
+                         "creator never finished it",
+                         name);
+    close();
+    return false;
+  }
+  return true;
+}
+
+bool ShmInput::read(ShmSample &sample) const {
+  constexpr int max_attempts = 64;
+  for (int attempt = 0; attempt < max_attempts; ++attempt) {
+    const LONG before = block_->sequence;
+    if (before & 1)
+      continue; // Write in progress
+    std::atomic_thread_fence(std::memory_order_acquire);
+    ShmSample read{before};
+    std::copy_n(block_->values, EXCSERIAL_SHM_CHANNELS, read.values.begin());
+    read.publish_qpc = block_->publish_qpc;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (block_->sequence == before) {
+      sample = read;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ShmInput::close() {
+  excserial_shm_close(block_, mapping_);
+  block_ = nullptr;
+  mapping_ = nullptr;
+}
+
+} // namespace excserial
@@ -0,0 +1,138 @@
+/**
+ * @file soak.cpp
+ * @brief Unpaced sending that keeps the link saturated for hours.
+ */
+
+#include "excserial/soak.h"
+
+#include "excserial/burst.h"
+
+#include <algorithm>
+
+namespace excserial {
+
+namespace {
+
+/// Shortest sleep worth taking, below this the next block is written.
+constexpr auto min_sleep = std::chrono::microseconds(200);
+
+} // namespace
+
+double SoakStats::throughput() const {
+  if (elapsed <= std::chrono::nanoseconds::zero())
+    return 0.0;
+  return static_cast<double>(bytes - std::min(queued_bytes, bytes)) /
+         std::chrono::duration<double>(elapsed).count();
+}
+
+SoakSender::~SoakSender() {
+  stop();
+}
+
+bool SoakSender::start(Port &port, double line_limit,
+                       std::chrono::nanoseconds fill, const Values &values,
+                       bool alternate, FrameFormat format) {
+  stop();
+  if (!(line_limit > 0.0)) {
+    error_ = "Line limit must be positive";
+    return false;
+  }
+  fill_bytes_ = static_cast<std::size_t>(
+      line_limit * std::chrono::duration<double>(fill).count());
+  if (fill_bytes_ < 2 * max_frame_size) {
+    error_ = "Fill level must hold at least two frames";
+    return false;
+  }
+
+  // Whole frames up to half the fill level, pairs so every block starts
+  // with the same sign
+  std::vector<char> pair;
+  encode_burst(values, 2, alternate, pair, format);
+  block_frames_ = static_cast<std::uint32_t>(
+      std::max<std::size_t>(fill_bytes_ / 2 / pair.size(), 1) * 2);
+  block_.clear();
+  encode_burst(values, block_frames_, alternate, block_, format);
+
+  port_ = &port;
+  line_limit_ = line_limit;
+  error_.clear();
+  blocks_ = 0;
+  queued_bytes_ = 0;
+  elapsed_ns_ = 0;
+  min_window_ = 0.0;
+  stop_requested_ = false;
+  running_ = true;
+  start_ = clock_.now();
+  thread_ = std::thread(&SoakSender::run, this);
+  return true;
+}
+
+void SoakSender::stop() {
+  stop_requested_ = true;
+  if (thread_.joinable())
+    thread_.join();
+}
+
+SoakStats SoakSender::stats() const {
+  SoakStats stats;
+  const auto blocks = blocks_.load(std::memory_order_relaxed);
+  stats.frames = blocks * block_frames_;
+  stats.bytes = blocks * block_.size();
+  stats.queued_bytes = queued_bytes_.load(std::memory_order_relaxed);
+  stats.elapsed =
+      std::chrono::nanoseconds{elapsed_ns_.load(std::memory_order_relaxed)};
+  stats.min_window_throughput = min_window_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void SoakSender::run() {
+  auto window_start = start_;
+  std::uint64_t window_bytes = 0;
+  std::uint64_t window_queued = 0;
+  auto queued = port_->queued_bytes();
+
+  while (!stop_requested_.load(std::memory_order_relaxed)) {
+    if (queued + block_.size() <= fill_bytes_) {
+      if (!port_->write(block_)) {
+        error_ = port_->error();
+        break;
+      }
+      blocks_.fetch_add(1, std::memory_order_relaxed);
+      window_bytes += block_.size();
+    } else {
+      // Until one block has drained at the line rate
+      const auto excess = queued + block_.size() - fill_bytes_;
+      const auto drain = std::chrono::nanoseconds{static_cast<std::int64_t>(
+          static_cast<double>(excess) / line_limit_ * 1e9)};
+      clock_.sleep_until(clock_.now() + std::max<std::chrono::nanoseconds>(
+                                            drain, min_sleep));
+    }
+
+    // Asked again rather than guessed, part of the block may have left
+    // already, or all of it with drivers that complete writes on the wire
+    queued = port_->queued_bytes();
+    const auto now = clock_.now();
+    queued_bytes_.store(queued, std::memory_order_relaxed);
+    elapsed_ns_.store(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(now - start_)
+            .count(),
+        std::memory_order_relaxed);
+    if (now - window_start >= window) {
+      // Bytes that left the queue during the window
+      const auto passed = window_queued + window_bytes;
+      const auto sent = passed - std::min<std::uint64_t>(queued, passed);
+      const auto rate = static_cast<double>(sent) /
+                        std::chrono::duration<double>(now - window_start)
+                            .count();
+      const auto lowest = min_window_.load(std::memory_order_relaxed);
+      if (lowest == 0.0 || rate < lowest)
+        min_window_.store(rate, std::memory_order_relaxed);
+      window_start = now;
+      window_bytes = 0;
+      window_queued = queued;
+    }
+  }
+  running_.store(false, std::memory_order_release);
+}
+
+} // namespace excserial
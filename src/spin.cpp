@@ -0,0 +1,150 @@
+/**
+ * @file spin.cpp
+ * @brief Busy waiting for the final microseconds before a deadline.
+ */
+
+#include "excserial/spin.h"
+
+#include <algorithm>
+#include <windows.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) ||             \
+    defined(__i386__)
+#define EXCSERIAL_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+#endif
+
+namespace excserial {
+
+namespace {
+
+using steady = std::chrono::steady_clock;
+
+#ifdef EXCSERIAL_X86
+
+bool detect_waitpkg() {
+  // CPUID.(EAX=7,ECX=0):ECX bit 5
+#ifdef _MSC_VER
+  int regs[4] = {};
+  __cpuidex(regs, 0, 0);
+  if (regs[0] < 7)
+    return false;
+  __cpuidex(regs, 7, 0);
+  return (regs[2] & (1 << 5)) != 0;
+#else
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+    return false;
+  return (ecx & (1u << 5)) != 0;
+#endif
+}
+
+/// TSC ticks per nanosecond, measured once against the steady clock.
+double tsc_per_ns() {
+  static const double rate = [] {
+    const auto start = steady::now();
+    const auto tsc_start = __rdtsc();
+    while (steady::now() - start < std::chrono::milliseconds(10)) {
+    }
+    const auto tsc_end = __rdtsc();
+    const std::chrono::duration<double, std::nano> elapsed =
+        steady::now() - start;
+    return static_cast<double>(tsc_end - tsc_start) / elapsed.count();
+  }();
+  return rate;
+}
+
+// clang-cl defines _MSC_VER but needs the attribute like clang
+#if defined(__clang__) || defined(__GNUC__)
+__attribute__((target("waitpkg")))
+#endif
+void tpause_for(std::uint64_t tsc_ticks) {
+  // Control 0 selects C0.2, the deeper of the two light sleep states. The OS
+  // caps each wait (IA32_UMWAIT_CONTROL), the caller loops anyway.
+  _tpause(0, __rdtsc() + tsc_ticks);
+}
+
+#endif // EXCSERIAL_X86
+
+void cpu_relax() {
+#ifdef EXCSERIAL_X86
+  _mm_pause();
+#else
+  YieldProcessor();
+#endif
+}
+
+} // namespace
+
+std::string_view to_string(SpinMode mode) {
+  switch (mode) {
+  case SpinMode::yield:
+    return "yield";
+  case SpinMode::pause:
+    return "pause";
+  case SpinMode::tpause:
+    return "tpause";
+  }
+  return "unknown";
+}
+
+std::optional<SpinMode> parse_spin_mode(std::string_view name) {
+  for (const auto mode : spin_modes) {
+    if (to_string(mode) == name)
+      return mode;
+  }
+  return std::nullopt;
+}
+
+bool tpause_supported() {
+#ifdef EXCSERIAL_X86
+  static const bool supported = detect_waitpkg();
+  return supported;
+#else
+  return false;
+#endif
+}
+
+std::uint64_t spin_until(steady::time_point deadline, SpinMode mode) {
+  if (mode == SpinMode::tpause && !tpause_supported())
+    mode = SpinMode::pause;
+
+  std::uint64_t turns = 0;
+  for (auto now = steady::now(); now < deadline; now = steady::now()) {
+    ++turns;
+    switch (mode) {
+    case SpinMode::yield:
+      Sleep(0); // Yield CPU
+      break;
+    case SpinMode::pause:
+      cpu_relax();
+      break;
+    case SpinMode::tpause: {
+#ifdef EXCSERIAL_X86
+      // Short slices keep a calibration error from overshooting the
+      // deadline, the last microsecond is spun with pause
+      constexpr auto max_slice = std::chrono::microseconds(20);
+      const auto remaining = deadline - now;
+      if (remaining <= std::chrono::microseconds(1)) {
+        cpu_relax();
+        break;
+      }
+      const std::chrono::duration<double, std::nano> slice =
+          std::min<steady::duration>(remaining - std::chrono::microseconds(1),
+                                     max_slice);
+      tpause_for(static_cast<std::uint64_t>(slice.count() * tsc_per_ns()));
+#endif
+      break;
+    }
+    }
+  }
+  return turns;
+}
+
+} // namespace excserial
@@ -0,0 +1,54 @@
+/**
+ * @file spin_tuner.cpp
+ * @brief Learns how long the hybrid pacer has to spin.
+ */
+
+#include "excserial/spin_tuner.h"
+
+#include <algorithm>
+
+namespace excserial {
+
+SpinWindowTuner::SpinWindowTuner(double percentile,
+                                 std::chrono::nanoseconds margin)
+    : margin_(margin) {
+  set_percentile(percentile);
+}
+
+void SpinWindowTuner::set_percentile(double percentile) {
+  percentile_ = std::clamp(percentile, 0.5, 0.99999);
+}
+
+void SpinWindowTuner::add(std::chrono::nanoseconds overshoot) {
+  const auto us =
+      std::chrono::duration_cast<std::chrono::microseconds>(overshoot).count();
+  counts_[log_buckets::of(us)] += 1.0f;
+  total_ += 1.0f;
+
+  ++samples_;
+  if (samples_ % decay_interval == 0) {
+    for (auto &count : counts_)
+      count *= 0.5f;
+    total_ *= 0.5f;
+  }
+  if (samples_ % update_interval == 0)
+    update_window();
+}
+
+void SpinWindowTuner::update_window() {
+  // Upper bucket edge of the percentile, errs on spinning slightly longer
+  const float target = static_cast<float>(percentile_) * total_;
+  float seen = 0.0f;
+  std::size_t bucket = 0;
+  for (; bucket < bucket_count - 1; ++bucket) {
+    seen += counts_[bucket];
+    if (seen >= target)
+      break;
+  }
+  const auto window =
+      std::chrono::microseconds(log_buckets::upper_us(bucket)) + margin_;
+  window_ = std::clamp<std::chrono::nanoseconds>(window, min_window,
+                                                 max_window);
+}
+
+} // namespace excserial
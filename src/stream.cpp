@@ -0,0 +1,277 @@
+/**
+ * @file stream.cpp
+ * @brief High-rate frame stream to one serial port.
+ */
+
+#include "excserial/stream.h"
+
+#include "excserial/error.h"
+#include "excserial/link_budget.h"
+#include "excserial/wall_clock.h"
+
+#include <algorithm>
+#include <format>
+
+namespace excserial {
+
+Stream::~Stream() {
+  stop();
+}
+
+bool Stream::open_port(std::string_view name, const PortSettings &settings) {
+  if (running()) {
+    error_ = "Can't open a port while the stream is running";
+    return false;
+  }
+  if (!serial_.open(name, settings)) {
+    error_ = serial_.error();
+    return false;
+  }
+  port_ = &serial_;
+  return true;
+}
+
+bool Stream::start(const StreamConfig &config) {
+  stop();
+  if (port_ == &serial_ && !serial_.is_open()) {
+    error_ = "Port is not open";
+    return false;
+  }
+  if (!(config.rate_hz > 0.0)) {
+    error_ = "Rate must be positive";
+    return false;
+  }
+  if (config.trajectory.size() % channel_count != 0) {
+    error_ = "Trajectory size must be a multiple of the channel count";
+    return false;
+  }
+  if (!config.shm_name.empty() && !config.trajectory.empty()) {
+    error_ = "Can't combine shared memory input with a trajectory";
+    return false;
+  }
+  if (config.shm_range < 0) {
+    error_ = "Shared memory range must not be negative";
+    return false;
+  }
+  if (port_ == &serial_) {
+    // Shared memory values are anywhere within their range
+    const auto range = config.shm_range;
+    const Values bounds{range, range, range, range};
+    const auto frame_bytes =
+        config.shm_name.empty()
+            ? worst_frame_size(config.format, &config.values,
+                               config.alternate, config.trajectory)
+            : worst_frame_size(config.format, range > 0 ? &bounds : nullptr,
+                               true);
+    const auto budget = plan_link(config.format, frame_bytes,
+                                  serial_.settings(), config.rate_hz);
+    if (!budget.feasible()) {
+      error_ = std::format("{} Hz of {} byte frames needs {:.0f}% of the "
+                           "line, {}",
+                           config.rate_hz, frame_bytes, budget.load() * 100.0,
+                           link_advice(budget));
+      return false;
+    }
+  }
+  if (config.align_to_wall_clock && clock_ != &steady_clock_) {
+    error_ = "Wall clock alignment needs the steady clock";
+    return false;
+  }
+  if (!config.shm_name.empty() && !shm_.open(config.shm_name)) {
+    error_ = shm_.error();
+    return false;
+  }
+
+  if (!resolve_placement(config.placement, port_->name(), placement_,
+                         error_))
+    return false;
+
+  config_ = config;
+  period_ = Period::from_rate(config.rate_hz);
+  values_.store(config.values);
+  steady_clock_.set_mode(config.pacing);
+  steady_clock_.set_spin_mode(config.spin);
+  steady_clock_.set_lateness_percentile(config.lateness_percentile);
+  trace_.reset(0);
+  arena_.reset(TraceRing::bytes_needed(config.trace_capacity) + 4096,
+               placement_.thread_node);
+  trace_.reset(config.trace_capacity, arena_.resource());
+  error_.clear();
+  frames_sent_ = 0;
+  bytes_sent_ = 0;
+  heap_allocations_ = 0;
+  arena_overflow_ = 0;
+  lateness_.reset();
+  alignment_error_ns_ = 0;
+  sent_values_.store({});
+  queued_bytes_ = 0;
+  stop_requested_ = false;
+  running_ = true;
+  thread_ = std::thread(&Stream::run, this);
+  return true;
+}
+
+void Stream::update_values(const Values &values) {
+  std::lock_guard lock(update_mutex_); // ValueSlot allows one writer
+  values_.store(values);
+}
+
+void Stream::stop() {
+  stop_requested_ = true;
+  if (thread_.joinable())
+    thread_.join();
+  shm_.close();
+}
+
+StreamStats Stream::stats() {
+  StreamStats stats;
+  stats.frames_sent = frames_sent_.load(std::memory_order_relaxed);
+  stats.bytes_sent = bytes_sent_.load(std::memory_order_relaxed);
+  stats.heap_allocations = heap_allocations_.load(std::memory_order_relaxed);
+  stats.arena_overflow = arena_overflow_.load(std::memory_order_relaxed);
+
+  // The window is reset while the send thread may be adding to it, a sample
+  // landing in between is attributed to the next window at worst.
+  stats.latency_count = latency_count_.exchange(0);
+  const auto sum = latency_sum_ns_.exchange(0);
+  const auto min = latency_min_ns_.exchange(INT64_MAX);
+  const auto max = latency_max_ns_.exchange(0);
+  if (stats.latency_count > 0) {
+    stats.latency_min_us = static_cast<double>(min) / 1e3;
+    stats.latency_avg_us =
+        static_cast<double>(sum) / 1e3 / stats.latency_count;
+    stats.latency_max_us = static_cast<double>(max) / 1e3;
+  }
+  return stats;
+}
+
+void Stream::add_latency(std::int64_t latency_ns) {
+  // Only the send thread writes, so load and store don't race each other
+  if (latency_ns < latency_min_ns_.load(std::memory_order_relaxed))
+    latency_min_ns_.store(latency_ns, std::memory_order_relaxed);
+  if (latency_ns > latency_max_ns_.load(std::memory_order_relaxed))
+    latency_max_ns_.store(latency_ns, std::memory_order_relaxed);
+  latency_sum_ns_.fetch_add(latency_ns, std::memory_order_relaxed);
+  latency_count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Stream::run() {
+  // Before anything is touched, so the stack lands on the thread's node
+  if (!bind_current_thread(placement_)) {
+    error_ = std::format("Could not bind the send thread: {}",
+                         error_string(GetLastError()));
+    running_.store(false, std::memory_order_release);
+    return;
+  }
+
+  LARGE_INTEGER qpc_frequency;
+  QueryPerformanceFrequency(&qpc_frequency);
+
+  Pacer pacer{period_, *clock_};
+  WallClockAligner aligner;
+  if (config_.align_to_wall_clock)
+    pacer.reset(aligner.start(period_));
+  FrameBuffer frame;
+  FrameEncoder encoder{config_.format};
+  ShmSample sample;
+  LONG last_sequence = 0;
+  std::int32_t sign = 1;
+  const auto &trajectory = config_.trajectory;
+  std::size_t position = 0;
+
+  std::uint64_t frames = 0;
+  const bool tracing = trace_.enabled();
+  FrameTrace unused_trace;
+
+  // Setup above may allocate, the loop must not
+  const auto allocations_before = thread_heap_allocations();
+  while (!stop_requested_.load(std::memory_order_relaxed)) {
+    if (config_.frame_count != 0 && frames == config_.frame_count)
+      break;
+    if (!trajectory.empty() && position == trajectory.size()) {
+      if (!config_.loop)
+        break;
+      position = 0;
+    }
+
+    const auto woke = pacer.wait();
+    lateness_.add(woke - pacer.deadline());
+    FrameTrace &trace = tracing ? trace_.begin(frames) : unused_trace;
+    if (tracing) {
+      trace.deadline_ns =
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              pacer.deadline().time_since_epoch())
+              .count();
+      trace.stamp(TraceStage::wake, woke);
+    }
+
+    Values values;
+    if (!trajectory.empty()) {
+      std::copy_n(trajectory.begin() + position, channel_count,
+                  values.begin());
+      position += channel_count;
+    } else if (shm_.is_open()) {
+      shm_.read(sample);
+      values = sample.values;
+      if (config_.shm_range > 0) {
+        for (auto &value : values)
+          value = std::clamp(value, -config_.shm_range, config_.shm_range);
+      }
+    } else {
+      values = values_.load();
+    }
+    if (config_.alternate) {
+      for (auto &value : values)
+        value *= sign;
+      sign = -sign;
+    }
+
+    if (tracing)
+      trace.stamp(TraceStage::generate, clock_->now());
+
+    const auto size = encoder.encode(values, frame);
+    if (tracing) {
+      trace.stamp(TraceStage::encode, clock_->now());
+      trace.stamp(TraceStage::write_enter, clock_->now());
+    }
+    const bool written = port_->write({frame.data(), size});
+    if (tracing) {
+      trace.stamp(TraceStage::write_return, clock_->now());
+      trace_.commit();
+    }
+    if (!written) {
+      error_ = port_->error();
+      break;
+    }
+    if (telemetry_requested_.load(std::memory_order_relaxed)) {
+      telemetry_requested_.store(false, std::memory_order_relaxed);
+      sent_values_.store(values);
+      queued_bytes_.store(port_->queued_bytes(), std::memory_order_relaxed);
+    }
+    if (config_.align_to_wall_clock) {
+      pacer.shift(aligner.update(pacer.start()));
+      alignment_error_ns_.store(aligner.error().count(),
+                                std::memory_order_relaxed);
+    }
+    ++frames;
+    frames_sent_.fetch_add(1, std::memory_order_relaxed);
+    bytes_sent_.fetch_add(size, std::memory_order_relaxed);
+
+    // Only fresh samples count, a value resent on later ticks has no latency
+    if (sample.sequence != last_sequence) {
+      LARGE_INTEGER written;
+      QueryPerformanceCounter(&written);
+      add_latency(static_cast<std::int64_t>(
+          static_cast<double>(written.QuadPart - sample.publish_qpc) * 1e9 /
+          static_cast<double>(qpc_frequency.QuadPart)));
+      last_sequence = sample.sequence;
+    }
+  }
+
+  heap_allocations_.store(thread_heap_allocations() - allocations_before,
+                          std::memory_order_relaxed);
+  arena_overflow_.store(arena_.overflow(), std::memory_order_relaxed);
+  running_.store(false, std::memory_order_release);
+}
+
+} // namespace excserial
@@ -0,0 +1,141 @@
+/**
+ * @file timer_wheel.cpp
+ * @brief Hierarchical timer wheel for stream deadlines.
+ */
+
+#include "excserial/timer_wheel.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace excserial {
+
+TimerWheel::TimerWheel(std::size_t capacity,
+                       std::pmr::memory_resource *memory)
+    : expiry_(memory), next_(memory) {
+  reserve(capacity);
+}
+
+void TimerWheel::reserve(std::size_t capacity) {
+  expiry_.resize(capacity);
+  next_.resize(capacity, none);
+}
+
+void TimerWheel::push(List &list, std::uint32_t id) {
+  next_[id] = list.head;
+  list.head = id;
+  list.earliest = std::min(list.earliest, expiry_[id]);
+}
+
+void TimerWheel::place(std::uint32_t id) {
+  const auto tick = expiry_[id];
+  if (tick <= now_) {
+    push(due_, id);
+    return;
+  }
+  // The highest 6 bit group where expiry and now differ picks the level
+  const auto level =
+      static_cast<unsigned>(std::bit_width(tick ^ now_) - 1) / slot_bits;
+  if (level >= level_count) {
+    push(overflow_, id);
+    return;
+  }
+  const auto slot =
+      static_cast<unsigned>(tick >> (level * slot_bits)) & (slot_count - 1);
+  push(slots_[level][slot], id);
+  occupied_[level] |= std::uint64_t{1} << slot;
+}
+
+void TimerWheel::schedule(std::uint32_t id, std::uint64_t tick) {
+  expiry_[id] = tick;
+  place(id);
+  ++size_;
+}
+
+void TimerWheel::cascade(unsigned level, unsigned slot) {
+  auto id = slots_[level][slot].head;
+  slots_[level][slot] = {};
+  occupied_[level] &= ~(std::uint64_t{1} << slot);
+  while (id != none) {
+    const auto next = next_[id];
+    place(id);
+    id = next;
+  }
+}
+
+void TimerWheel::refresh_overflow() {
+  // Overflow timers may fit once time enters a new wheel span
+  if (overflow_.head == none || (now_ >> span_bits) == overflow_span_)
+    return;
+  overflow_span_ = now_ >> span_bits;
+  auto id = overflow_.head;
+  overflow_ = {};
+  while (id != none) {
+    const auto next = next_[id];
+    place(id);
+    id = next;
+  }
+}
+
+std::optional<std::uint64_t> TimerWheel::next_expiry() const {
+  if (size_ == 0)
+    return std::nullopt;
+  if (due_.head != none)
+    return now_;
+
+  // Per level, the slot holding now and the first slot after it can both
+  // hold the earliest timer. Lower levels aren't always earlier: time may
+  // have moved into a higher level slot without expiring anything yet.
+  std::uint64_t earliest = overflow_.earliest;
+  for (unsigned level = 0; level < level_count; ++level) {
+    const auto current =
+        static_cast<unsigned>(now_ >> (level * slot_bits)) & 63;
+    const auto candidates = occupied_[level] & (~std::uint64_t{0} << current);
+    if (candidates == 0)
+      continue;
+    const auto slot = static_cast<unsigned>(std::countr_zero(candidates));
+    earliest = std::min(earliest, slots_[level][slot].earliest);
+    const auto after = candidates & (candidates - 1);
+    if (slot == current && after != 0) {
+      const auto next = static_cast<unsigned>(std::countr_zero(after));
+      earliest = std::min(earliest, slots_[level][next].earliest);
+    }
+  }
+  return earliest;
+}
+
+void TimerWheel::expire_now(std::pmr::vector<std::uint32_t> &expired) {
+  // Bring down every higher level slot time has moved into, top first so
+  // timers can fall through several levels
+  for (unsigned level = level_count - 1; level > 0; --level) {
+    const auto current =
+        static_cast<unsigned>(now_ >> (level * slot_bits)) & 63;
+    if (occupied_[level] & (std::uint64_t{1} << current))
+      cascade(level, current);
+  }
+
+  // What is left for this exact tick is in due_ and one level 0 slot
+  const auto slot = static_cast<unsigned>(now_) & (slot_count - 1);
+  for (auto *list : {&due_, &slots_[0][slot]}) {
+    for (auto id = list->head; id != none; id = next_[id]) {
+      expired.push_back(id);
+      --size_;
+    }
+    *list = {};
+  }
+  occupied_[0] &= ~(std::uint64_t{1} << slot);
+}
+
+void TimerWheel::advance(std::uint64_t tick,
+                         std::pmr::vector<std::uint32_t> &expired) {
+  for (auto next = next_expiry(); next && *next <= tick; next = next_expiry()) {
+    now_ = std::max(now_, *next);
+    refresh_overflow();
+    expire_now(expired);
+  }
+  // Every pending timer is later than tick, so all of them stay valid
+  now_ = std::max(now_, tick);
+  refresh_overflow();
+}
+
+} // namespace excserial
@@ -0,0 +1,126 @@
+/**
+ * @file trace.cpp
+ * @brief Per-frame stage timestamps for jitter attribution.
+ */
+
+#include "excserial/trace.h"
+
+#include <algorithm>
+#include <bit>
+#include <format>
+#include <memory>
+#include <type_traits>
+
+namespace excserial {
+
+void TraceRing::FreeSlots::operator()(Slot *slots) const {
+  static_assert(std::is_trivially_destructible_v<Slot>);
+  memory->deallocate(slots, count * sizeof(Slot), alignof(Slot));
+}
+
+std::size_t TraceRing::bytes_needed(std::size_t capacity) {
+  if (capacity == 0)
+    return 0;
+  return std::bit_ceil(std::max<std::size_t>(capacity, 2)) * sizeof(Slot);
+}
+
+void TraceRing::reset(std::size_t capacity,
+                      std::pmr::memory_resource *memory) {
+  head_ = 0;
+  slots_.reset();
+  mask_ = 0;
+  if (capacity == 0)
+    return;
+  capacity = std::bit_ceil(std::max<std::size_t>(capacity, 2));
+  auto *slots = static_cast<Slot *>(
+      memory->allocate(capacity * sizeof(Slot), alignof(Slot)));
+  std::uninitialized_value_construct_n(slots, capacity);
+  slots_ = {slots, FreeSlots{memory, capacity}};
+  mask_ = capacity - 1;
+}
+
+FrameTrace &TraceRing::begin(std::uint64_t frame) {
+  const auto head = head_.load(std::memory_order_relaxed);
+  Slot &slot = slots_[head & mask_];
+  // Odd while the slot is written, readers skip it
+  slot.sequence.store(2 * head + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.trace = FrameTrace{frame};
+  return slot.trace;
+}
+
+void TraceRing::commit() {
+  const auto head = head_.load(std::memory_order_relaxed);
+  slots_[head & mask_].sequence.store(2 * head + 2, std::memory_order_release);
+  head_.store(head + 1, std::memory_order_release);
+}
+
+std::vector<FrameTrace> TraceRing::snapshot() const {
+  std::vector<FrameTrace> traces;
+  if (!enabled())
+    return traces;
+
+  const auto head = head_.load(std::memory_order_acquire);
+  const auto capacity = static_cast<std::uint64_t>(mask_) + 1;
+  const auto first = head > capacity ? head - capacity : 0;
+  traces.reserve(static_cast<std::size_t>(head - first));
+  for (auto i = first; i < head; ++i) {
+    const Slot &slot = slots_[i & mask_];
+    if (slot.sequence.load(std::memory_order_acquire) != 2 * i + 2)
+      continue; // Overwritten since head was read
+    const FrameTrace copy = slot.trace;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) == 2 * i + 2)
+      traces.push_back(copy);
+  }
+  return traces;
+}
+
+void TraceRing::write_chrome_trace(std::ostream &out) const {
+  const auto traces = snapshot();
+  const std::int64_t origin =
+      traces.empty() ? 0 : traces.front().deadline_ns;
+  const auto us = [origin](std::int64_t ns) {
+    return static_cast<double>(ns - origin) / 1e3;
+  };
+  const auto at = [](const FrameTrace &trace, TraceStage stage) {
+    return trace.stamps_ns[static_cast<std::size_t>(stage)];
+  };
+
+  // One complete event per stage, wake-up lateness is measured from the
+  // deadline so scheduler delay shows up as its own slice
+  struct Span {
+    const char *name;
+    TraceStage from;
+    TraceStage to;
+  };
+  constexpr Span spans[] = {
+      {"generate", TraceStage::wake, TraceStage::generate},
+      {"encode", TraceStage::generate, TraceStage::encode},
+      {"write", TraceStage::write_enter, TraceStage::write_return},
+  };
+
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+  out << R"({"name":"thread_name","ph":"M","pid":1,"tid":1,)"
+      << R"("args":{"name":"send"}})";
+  for (const auto &trace : traces) {
+    const auto wake = at(trace, TraceStage::wake);
+    out << std::format(",\n{{\"name\":\"wake-up\",\"ph\":\"X\",\"pid\":1,"
+                       "\"tid\":1,\"ts\":{:.3f},\"dur\":{:.3f},"
+                       "\"args\":{{\"frame\":{},\"late_us\":{:.3f}}}}}",
+                       us(trace.deadline_ns), us(wake) - us(trace.deadline_ns),
+                       trace.frame,
+                       static_cast<double>(wake - trace.deadline_ns) / 1e3);
+    for (const auto &span : spans) {
+      const auto from = at(trace, span.from);
+      out << std::format(",\n{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":1,"
+                         "\"tid\":1,\"ts\":{:.3f},\"dur\":{:.3f},"
+                         "\"args\":{{\"frame\":{}}}}}",
+                         span.name, us(from), us(at(trace, span.to)) - us(from),
+                         trace.frame);
+    }
+  }
+  out << "\n]}\n";
+}
+
+} // namespace excserial
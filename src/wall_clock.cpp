@@ -0,0 +1,91 @@
+/**
+ * @file wall_clock.cpp
+ * @brief Aligning the tick schedule to wall-clock seconds.
+ */
+
+#include "excserial/wall_clock.h"
+
+#include <algorithm>
+#include <windows.h>
+
+namespace excserial {
+
+namespace {
+
+/// 100 ns intervals from 1601-01-01, the FILETIME epoch, to 1970-01-01.
+constexpr std::int64_t unix_epoch_filetime = 116'444'736'000'000'000;
+
+constexpr std::int64_t ns_per_s = 1'000'000'000;
+
+/// Samples taken further apart than this were preempted and are dropped.
+constexpr std::int64_t max_sample_ns = 20'000;
+
+/// Weight of a new offset sample is 1 / offset_filter.
+constexpr std::int64_t offset_filter = 16;
+
+std::int64_t steady_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+} // namespace
+
+std::chrono::nanoseconds wall_clock_now() {
+  FILETIME time;
+  GetSystemTimePreciseAsFileTime(&time);
+  const auto intervals =
+      (static_cast<std::int64_t>(time.dwHighDateTime) << 32) |
+      time.dwLowDateTime;
+  return std::chrono::nanoseconds{(intervals - unix_epoch_filetime) * 100};
+}
+
+bool WallClockAligner::sample_offset(std::int64_t &offset_ns) {
+  const auto before = steady_ns();
+  const auto wall = wall_clock_now().count();
+  const auto after = steady_ns();
+  offset_ns = wall - (before + (after - before) / 2);
+  return after - before <= max_sample_ns;
+}
+
+Clock::time_point WallClockAligner::start(const Period &period) {
+  period_ns_ = period.rounded().count();
+  max_step_ns_ = std::max<std::int64_t>(
+      static_cast<std::int64_t>(static_cast<double>(period_ns_) * max_slew),
+      1);
+  // A preempted sample is only less accurate, keep the last one if no
+  // attempt gets through undisturbed
+  for (int attempt = 0; attempt < 8; ++attempt) {
+    if (sample_offset(offset_ns_))
+      break;
+  }
+  error_ns_ = 0;
+
+  const auto now = steady_ns() + offset_ns_;
+  origin_ns_ = (now / ns_per_s + 1) * ns_per_s;
+  return Clock::time_point{std::chrono::nanoseconds{origin_ns_ - offset_ns_}};
+}
+
+std::chrono::nanoseconds
+WallClockAligner::update(Clock::time_point schedule_start) {
+  std::int64_t sample = 0;
+  if (sample_offset(sample))
+    offset_ns_ += (sample - offset_ns_) / offset_filter;
+
+  // Every tick is off the grid by the same amount, and the grid repeats
+  // every period, so only the phase within one period matters
+  const auto start_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          schedule_start.time_since_epoch())
+          .count();
+  auto phase = (start_ns + offset_ns_ - origin_ns_) % period_ns_;
+  if (phase > period_ns_ / 2)
+    phase -= period_ns_;
+  else if (phase <= -period_ns_ / 2)
+    phase += period_ns_;
+  error_ns_ = phase;
+  return std::chrono::nanoseconds{
+      -std::clamp(phase, -max_step_ns_, max_step_ns_)};
+}
+
+} // namespace excserial
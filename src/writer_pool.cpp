@@ -0,0 +1,147 @@
+/**
+ * @file writer_pool.cpp
+ * @brief Few threads writing to many ports.
+ */
+
+#include "excserial/writer_pool.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace excserial {
+
+WriterPool::WriterPool(std::span<Port *const> ports, std::size_t threads) {
+  const std::size_t cores =
+      std::max(1u, std::thread::hardware_concurrency());
+  if (threads == 0)
+    threads = std::min(cores, (ports.size() + 15) / 16);
+  threads = std::clamp<std::size_t>(threads, 1,
+                                    std::max<std::size_t>(ports.size(), 1));
+
+  ports_.reserve(ports.size());
+  for (auto *port : ports) {
+    auto &slot = ports_.emplace_back(std::make_unique<PortSlot>());
+    slot->port = port;
+  }
+  workers_.reserve(threads);
+  for (std::size_t i = 0; i < threads; ++i) {
+    workers_.push_back(std::make_unique<Worker>());
+    workers_.back()->tasks.resize(std::max<std::size_t>(ports.size(), 1));
+  }
+  for (std::size_t i = 0; i < threads; ++i)
+    workers_[i]->thread = std::thread(&WriterPool::run, this, i);
+}
+
+WriterPool::~WriterPool() {
+  stop();
+}
+
+void WriterPool::submit(std::size_t port, std::span<const char> data) {
+  auto &slot = *ports_[port];
+  {
+    std::lock_guard lock(slot.mutex);
+    if (slot.has_frame)
+      slot.dropped.fetch_add(1, std::memory_order_relaxed);
+    std::memcpy(slot.frame.data(), data.data(), data.size());
+    slot.size = data.size();
+    slot.has_frame = true;
+    if (slot.queued)
+      return; // The thread writing the port picks the new frame up
+    slot.queued = true;
+  }
+
+  // Home thread by port keeps a port's tasks together while nobody steals
+  auto &home = *workers_[port % workers_.size()];
+  {
+    std::lock_guard lock(home.mutex);
+    home.tasks[(home.first + home.count++) % home.tasks.size()] =
+        static_cast<std::uint32_t>(port);
+  }
+  work_.release();
+}
+
+void WriterPool::stop() {
+  if (stopping_.exchange(true))
+    return;
+  // One extra release per thread, each exits once it finds no task left
+  work_.release(static_cast<std::ptrdiff_t>(workers_.size()));
+  for (auto &worker : workers_)
+    worker->thread.join();
+}
+
+std::uint64_t WriterPool::writes() const {
+  std::uint64_t total = 0;
+  for (const auto &slot : ports_)
+    total += slot->writes.load(std::memory_order_relaxed);
+  return total;
+}
+
+std::uint64_t WriterPool::dropped() const {
+  std::uint64_t total = 0;
+  for (const auto &slot : ports_)
+    total += slot->dropped.load(std::memory_order_relaxed);
+  return total;
+}
+
+bool WriterPool::take(std::size_t self, std::uint32_t &port) {
+  {
+    auto &own = *workers_[self];
+    std::lock_guard lock(own.mutex);
+    if (own.count > 0) {
+      port = own.tasks[(own.first + --own.count) % own.tasks.size()];
+      return true;
+    }
+  }
+  // Steal the oldest task of the next thread that has one
+  for (std::size_t i = 1; i < workers_.size(); ++i) {
+    auto &victim = *workers_[(self + i) % workers_.size()];
+    std::lock_guard lock(victim.mutex);
+    if (victim.count > 0) {
+      port = victim.tasks[victim.first];
+      victim.first = (victim.first + 1) % victim.tasks.size();
+      --victim.count;
+      return true;
+    }
+  }
+  return false;
+}
+
+void WriterPool::drain(std::uint32_t port) {
+  auto &slot = *ports_[port];
+  FrameBuffer frame;
+  while (true) {
+    std::size_t size = 0;
+    {
+      std::lock_guard lock(slot.mutex);
+      if (!slot.has_frame) {
+        slot.queued = false;
+        return;
+      }
+      std::memcpy(frame.data(), slot.frame.data(), slot.size);
+      size = slot.size;
+      slot.has_frame = false;
+    }
+    if (!slot.port->write({frame.data(), size})) {
+      std::call_once(error_once_, [&] {
+        error_ = slot.port->name() + ": " + slot.port->error();
+        failed_.store(true, std::memory_order_release);
+      });
+      continue;
+    }
+    slot.writes.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void WriterPool::run(std::size_t self) {
+  while (true) {
+    work_.acquire();
+    std::uint32_t port = 0;
+    if (take(self, port)) {
+      drain(port);
+    } else if (stopping_.load(std::memory_order_acquire)) {
+      return;
+    }
+  }
+}
+
+} // namespace excserial
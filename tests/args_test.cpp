@@ -0,0 +1,179 @@
+/**
+ * @file args_test.cpp
+ * @brief Every documented command line parses and fits its line, and rates
+ * are still checked where they are used.
+ */
+
+#include "check.h"
+
+#include "excserial/args.h"
+
+#include <chrono>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+using excserial::test::check;
+
+/// Command lines from the usage text and the README, without "excserial".
+constexpr std::string_view documented[] = {
+    // Usage text
+    "COM3 10 500",
+    "COM3 0 250 --shm sim --range 1000",
+    "sim 10 500 --virtual 600",
+    "COM3 10 1000 --format binary --baud 230400",
+    "COM3 10 100 --device 1 --device 2@250:1 --rts manual",
+    "COM3 0 100 --poll 1 --poll 2@50 --registers 100+8",
+    "COM3 10 500 --trace trace.json",
+    "COM3 10 500 --pacing hybrid",
+    "COM3 10 50 --stream 12@1000 --baud 230400",
+    "COM3,COM4 10 50 --stream 12@1000 --writers 2 --baud 230400",
+    "COM3 10 500 --dashboard 4",
+    "COM3 10 0 --burst 50x10@100 --baud 921600",
+    "COM3 10 0 --soak 20",
+    "COM3 10 500 --align utc",
+    "COM3 10 500 --numa-node port",
+    "selftest COM3 --jitter-budget 50",
+    // README
+    "sim 15 250 --virtual 600",
+    "COM3 15 250 --trace trace.json",
+    "COM3 15 500 --dashboard 4",
+    "COM3,COM4 15 50 --stream 12@100 --dashboard 4",
+    "COM3 15 250",
+    "COM3 15 0 --burst 50x10@100",
+    "COM3 15 0 --burst 50x10@100 --baud 921600",
+    "COM3 15 0 --soak 20 --baud 921600",
+    "COM3 15 500 --align utc",
+    "COM3 15 50 --stream 12@1000 --baud 230400",
+    "COM3,COM4,COM5 15 50 --stream 12@1000 --writers 2 --baud 230400",
+    "COM3 15 100 --device 1 --device 2@250:1 --rts manual",
+    "COM3 15 500 --numa-node port",
+    "COM3 0 250 --shm sim --range 1000",
+};
+
+/// Splits a command line at spaces and parses it.
+struct Parsed {
+  std::vector<std::string> words;
+  excserial::Options options;
+  excserial::ArgError error;
+  bool ok = false;
+
+  explicit Parsed(std::string_view line) {
+    std::istringstream in{std::string(line)};
+    for (std::string word; in >> word;)
+      words.push_back(word);
+    std::vector<const char *> args;
+    for (const auto &word : words)
+      args.push_back(word.c_str());
+    ok = excserial::parse_args(args, options, error);
+  }
+};
+
+void check_documented() {
+  for (const auto line : documented) {
+    const Parsed parsed{line};
+    check(parsed.ok, std::string(line) + ": " +
+                         std::string(parsed.error.message));
+  }
+}
+
+/// The rate is unused with --burst and --soak, 0 is what the usage text
+/// shows.
+void check_unpaced() {
+  const Parsed parsed{"COM3 15 0 --burst 50x10@100"};
+  if (!check(parsed.ok && parsed.options.burst.has_value(), "burst parses"))
+    return;
+  const auto &burst = *parsed.options.burst;
+  check(burst.frames == 50 && burst.repetitions == 10 &&
+            burst.gap == std::chrono::milliseconds(100),
+        "burst pattern is 50 frames, 10 times, 100 ms apart");
+
+  const Parsed soak{"COM3 10 0 --soak 20"};
+  check(soak.ok && soak.options.soak_fill == std::chrono::milliseconds(20),
+        "soak parses with 20 ms queued");
+}
+
+void check_rate_limits() {
+  const Parsed zero{"COM3 15 0"};
+  check(!zero.ok && zero.error.message == "Frequency must be positive" &&
+            zero.error.arg == "0",
+        "paced run needs a positive rate");
+  const Parsed fast{"COM3 15 1001"};
+  check(!fast.ok && fast.error.arg == "1001",
+        "paced run is limited to 1000 Hz");
+  const Parsed negative{"COM3 15 -5 --stream 12@100"};
+  check(!negative.ok && negative.error.arg == "-5",
+        "multi-rate run needs a positive base rate");
+}
+
+/// Worst case load of a command line at its --baud, as the executable
+/// plans it.
+std::optional<excserial::LinkBudget> budget_of(const Parsed &parsed) {
+  return excserial::plan_link(parsed.options,
+                              {.baud_rate = parsed.options.baud_rate});
+}
+
+/// The documented command lines leave the line some headroom, the ones
+/// documented before didn't.
+void check_link_budget() {
+  for (const auto line : documented) {
+    const Parsed parsed{line};
+    const auto budget = budget_of(parsed);
+    check(!budget || budget->has_headroom(),
+          std::string(line) + ": fits the line with headroom");
+  }
+  for (const auto line :
+       {"COM3 15 1000 --dashboard 4", "COM3 15 50 --stream 12@1000",
+        "COM3 15 100 --device 1 --device 2@500:1", "COM3 0 1000 --shm sim",
+        "COM3 0 250 --shm sim"}) {
+    const Parsed parsed{line};
+    const auto budget = budget_of(parsed);
+    check(parsed.ok && budget && !budget->has_headroom(),
+          std::string(line) + ": has no headroom at 115200 baud");
+  }
+
+  // Text addresses are "@1" and "@2", not max_address_size
+  const auto bus =
+      budget_of(Parsed{"COM3 15 100 --device 1 --device 2@250:1"});
+  check(bus && bus->frame_bytes == 19 && bus->rate_hz == 350.0,
+        "bus frames count their real address header");
+  // Without --range the shm values could be anything
+  const auto shm = budget_of(Parsed{"COM3 0 250 --shm sim --range 1000"});
+  check(shm && shm->frame_bytes == 25, "--range bounds shm frames");
+  check(!Parsed{"COM3 10 250 --range 1000"}.ok, "--range needs --shm");
+}
+
+/// Options only one run mode reads are refused with the others.
+void check_conflicts() {
+  const Parsed trace{"COM3 10 50 --stream 12@1000 --trace trace.json"};
+  check(!trace.ok, "--trace is refused with --stream");
+}
+
+/// Durations too long for nanoseconds are refused, not converted.
+void check_out_of_range() {
+  for (const auto line :
+       {"selftest --jitter-budget 1e300", "COM3 10 0 --burst 5x1@1e300",
+        "sim 10 500 --virtual 1e300", "COM3 10 0 --soak 1e300",
+        "COM3 10 100 --device 1 --turnaround 1e300",
+        "COM3 0 100 --poll 1 --response-timeout 1e300"}) {
+    const Parsed parsed{line};
+    check(!parsed.ok && parsed.error.arg.ends_with("1e300"),
+          std::string(line) + ": huge duration is refused");
+  }
+}
+
+} // namespace
+
+int main() {
+  check_documented();
+  check_link_budget();
+  check_unpaced();
+  check_rate_limits();
+  check_conflicts();
+  check_out_of_range();
+  return excserial::test::result();
+}
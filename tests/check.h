@@ -0,0 +1,35 @@
+/**
+ * @file check.h
+ * @brief Minimal assertions shared by the test executables.
+ *
+ * Every test is a plain executable run by ctest. A failed check prints what
+ * went wrong and the test carries on, so one run shows every failure, and
+ * main() returns result().
+ */
+
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+#include <string_view>
+
+namespace excserial::test {
+
+/// Checks failed so far.
+inline int failures = 0;
+
+/// Counts and reports a failure unless condition holds.
+inline bool check(bool condition, std::string_view what) {
+  if (!condition) {
+    ++failures;
+    std::cerr << "FAILED: " << what << std::endl;
+  }
+  return condition;
+}
+
+/// Exit code of the test.
+inline int result() {
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+} // namespace excserial::test
@@ -0,0 +1,199 @@
+/**
+ * @file golden_test.cpp
+ * @brief Byte streams of every waveform and frame format against golden
+ * hashes, and a floor on how fast they are generated.
+ *
+ * Usage: golden_test GOLDEN_DIR [MIN_FRAMES_PER_S] [--update]
+ * Runs each waveform in every frame format in virtual time against a
+ * CapturePort and compares the stream hash with GOLDEN_DIR/<waveform>-
+ * <format>.hash. --update rewrites the files instead, for intended changes
+ * of the output.
+ */
+
+#include "check.h"
+
+#include "excserial/args.h"
+#include "excserial/capture_port.h"
+#include "excserial/clock.h"
+#include "excserial/frame.h"
+#include "excserial/stream.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using excserial::test::check;
+
+/// Long enough that thread start and the polling below are noise.
+constexpr std::uint64_t frames_per_run = 1'000'000;
+
+struct Waveform {
+  std::string_view name;
+  excserial::Values values{};
+  bool alternate = false;
+  std::span<const std::int32_t> trajectory;
+};
+
+/// 1 Hz sine of amplitude 1000 at 1 kHz, the channels a quarter period
+/// apart, as slowly moving setpoints are.
+std::vector<std::int32_t> sine_rows() {
+  constexpr std::size_t rows = 1000;
+  constexpr double two_pi = 6.283185307179586;
+  std::vector<std::int32_t> table;
+  for (std::size_t row = 0; row < rows; ++row) {
+    for (std::size_t channel = 0; channel < excserial::channel_count;
+         ++channel) {
+      const double phase =
+          static_cast<double>(row) / rows +
+          static_cast<double>(channel) / excserial::channel_count;
+      table.push_back(static_cast<std::int32_t>(
+          std::lround(1000.0 * std::sin(two_pi * phase))));
+    }
+  }
+  return table;
+}
+
+/// Ramps over the whole int32 range at different speeds, wrapping around,
+/// so every frame has long text values and large changes.
+std::vector<std::int32_t> ramp_rows() {
+  constexpr std::size_t rows = 4096;
+  std::vector<std::int32_t> table;
+  for (std::size_t row = 0; row < rows; ++row) {
+    for (std::size_t channel = 0; channel < excserial::channel_count;
+         ++channel) {
+      // From the lowest int32 up, a prime step apart per channel
+      const auto step = 1048573u * static_cast<std::uint32_t>(channel + 1);
+      table.push_back(static_cast<std::int32_t>(
+          0x80000000u + step * static_cast<std::uint32_t>(row)));
+    }
+  }
+  return table;
+}
+
+std::string hex(std::uint64_t value) {
+  std::ostringstream out;
+  out << std::hex << std::setw(16) << std::setfill('0') << value;
+  return out.str();
+}
+
+struct Run {
+  std::uint64_t hash = 0;
+  std::uint64_t frames = 0;
+  double frames_per_s = 0.0;
+};
+
+bool run(const Waveform &waveform, excserial::FrameFormat format,
+         Run &result) {
+  excserial::Stream stream;
+  excserial::CapturePort capture;
+  excserial::VirtualClock clock;
+  stream.use_port(capture);
+  stream.use_clock(clock);
+  const excserial::StreamConfig config{
+      .rate_hz = 1000.0,
+      .values = waveform.values,
+      .alternate = waveform.alternate,
+      .format = format,
+      .trajectory = waveform.trajectory,
+      .loop = true,
+      .frame_count = frames_per_run,
+  };
+
+  const auto start = std::chrono::steady_clock::now();
+  if (!stream.start(config)) {
+    std::cerr << stream.error() << std::endl;
+    return false;
+  }
+  while (stream.running())
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  const std::chrono::duration<double> wall =
+      std::chrono::steady_clock::now() - start;
+  stream.stop();
+  if (!stream.error().empty()) {
+    std::cerr << stream.error() << std::endl;
+    return false;
+  }
+
+  result.hash = capture.hash();
+  result.frames = stream.frames_sent();
+  result.frames_per_s = static_cast<double>(result.frames) / wall.count();
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cerr << "Usage: golden_test GOLDEN_DIR [MIN_FRAMES_PER_S] [--update]"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  const std::string golden_dir = argv[1];
+  double min_rate = 0.0;
+  bool update = false;
+  for (int i = 2; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    if (arg == "--update") {
+      update = true;
+    } else if (!excserial::parse_number(arg, min_rate) || min_rate < 0.0) {
+      std::cerr << "Invalid frame rate floor: " << arg << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  const auto sine = sine_rows();
+  const auto ramp = ramp_rows();
+  const Waveform waveforms[] = {
+      {.name = "alternating", .values = {15, 15, 15, 15}, .alternate = true},
+      {.name = "extreme",
+       .values = {-2147483647, 2147483647, -2147483647, 2147483647},
+       .alternate = true},
+      {.name = "constant", .values = {0, 1, -1000, 123456789}},
+      {.name = "sine", .trajectory = sine},
+      {.name = "ramp", .trajectory = ramp},
+  };
+
+  for (const auto &waveform : waveforms) {
+    for (const auto format : excserial::frame_formats) {
+      const auto name = std::string(waveform.name) + "-" +
+                        std::string(excserial::to_string(format));
+      Run result;
+      if (!check(run(waveform, format, result), name + ": run failed"))
+        continue;
+      std::cout << std::left << std::setw(20) << name << hex(result.hash)
+                << std::fixed << std::setprecision(0) << std::setw(12)
+                << std::right << result.frames_per_s << " frames/s"
+                << std::endl;
+
+      check(result.frames == frames_per_run, name + ": frames missing");
+      check(result.frames_per_s >= min_rate,
+            name + ": generated below the frame rate floor");
+
+      const auto path = golden_dir + "/" + name + ".hash";
+      if (update) {
+        std::ofstream file{path};
+        file << hex(result.hash) << '\n';
+        check(static_cast<bool>(file), path + ": could not write");
+        continue;
+      }
+      std::ifstream file{path};
+      std::string expected;
+      if (!check(static_cast<bool>(file >> expected), path + ": missing"))
+        continue;
+      check(expected == hex(result.hash),
+            name + ": stream hash differs from " + expected);
+    }
+  }
+  return excserial::test::result();
+}
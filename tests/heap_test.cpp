@@ -0,0 +1,155 @@
+/**
+ * @file heap_test.cpp
+ * @brief Heap allocations are counted per thread in every operator new
+ * form, and running streams allocate nothing outside their arena.
+ */
+
+#include "check.h"
+
+#include "excserial/arena.h"
+#include "excserial/capture_port.h"
+#include "excserial/clock.h"
+#include "excserial/scheduler.h"
+#include "excserial/stream.h"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using excserial::test::check;
+using excserial::thread_heap_allocations;
+
+struct alignas(64) CacheLine {
+  char bytes[64];
+};
+
+/// Publishes memory so the compiler can't elide the allocation under test.
+void *volatile escaped = nullptr;
+
+template <typename T> void release(T *memory) {
+  escaped = memory;
+  delete memory;
+}
+template <typename T> void release_array(T *memory) {
+  escaped = memory;
+  delete[] memory;
+}
+
+/// Allocations counted while calling allocate.
+template <typename Allocate> std::uint64_t count(Allocate allocate) {
+  const auto before = thread_heap_allocations();
+  allocate();
+  return thread_heap_allocations() - before;
+}
+
+void check_counting() {
+  check(count([] { release(new int); }) == 1, "new counts");
+  check(count([] { release_array(new int[16]); }) == 1, "new[] counts");
+  check(count([] { release(new (std::nothrow) int); }) == 1,
+        "nothrow new counts");
+  check(count([] { release(new CacheLine); }) == 1, "aligned new counts");
+  check(count([] { release_array(new CacheLine[4]); }) == 1,
+        "aligned new[] counts");
+  check(count([] {
+          std::vector<int> values(100);
+          escaped = values.data();
+        }) == 1,
+        "library allocations count");
+
+  std::uint64_t in_thread = 0;
+  std::thread worker([&in_thread] {
+    in_thread = count([] { release(new int); });
+  });
+  const auto before = thread_heap_allocations();
+  worker.join();
+  check(in_thread == 1, "allocations count on their own thread");
+  check(thread_heap_allocations() == before,
+        "other threads' allocations don't count here");
+}
+
+void check_arena_overflow() {
+  excserial::Arena arena;
+  arena.reset(256);
+  auto *memory = arena.resource();
+  check(count([memory] { escaped = memory->allocate(128, 64); }) == 0,
+        "arena serves what fits without the heap");
+  check(arena.overflow() == 0, "no overflow within capacity");
+  check(count([memory] { escaped = memory->allocate(1024, 64); }) == 1,
+        "arena falls back to the heap");
+  check(arena.overflow() >= 1024, "overflow counts the fallback bytes");
+}
+
+/// A traced virtual stream, the send loop must not touch the heap.
+void check_stream() {
+  excserial::Stream stream;
+  excserial::CapturePort capture;
+  excserial::VirtualClock clock;
+  stream.use_port(capture);
+  stream.use_clock(clock);
+  if (!check(stream.start({.rate_hz = 1000.0,
+                           .alternate = true,
+                           .frame_count = 100'000,
+                           .trace_capacity = 1024}),
+             "stream starts"))
+    return;
+  while (stream.running())
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  stream.stop();
+  const auto stats = stream.stats();
+  check(stats.frames_sent == 100'000, "stream sends every frame");
+  check(stats.heap_allocations == 0, "send loop doesn't allocate");
+  check(stats.arena_overflow == 0, "stream arena is large enough");
+}
+
+/// Many streams on several ports, the scheduler loop must not touch the
+/// heap, also while sampling dashboard telemetry.
+void check_scheduler() {
+  excserial::MultiRateScheduler scheduler;
+  excserial::VirtualClock clock;
+  std::vector<std::unique_ptr<excserial::CapturePort>> captures;
+  scheduler.use_clock(clock);
+  for (int port = 0; port < 4; ++port) {
+    captures.push_back(std::make_unique<excserial::CapturePort>());
+    const auto index = scheduler.add_port(*captures.back());
+    for (int stream = 0; stream < 50; ++stream) {
+      scheduler.add_stream({
+          .port = index,
+          .period = excserial::Period::from_rate(100.0 + stream * 17),
+          .channels = 1u << (stream % 4),
+      });
+    }
+  }
+  if (!check(scheduler.start(100'000), "scheduler starts"))
+    return;
+  while (scheduler.running()) {
+    scheduler.request_telemetry();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  scheduler.stop();
+  check(scheduler.error().empty(), "scheduler runs without error");
+  std::uint64_t frames = 0;
+  for (std::size_t port = 0; port < captures.size(); ++port) {
+    const auto counters = scheduler.port_counters(port);
+    frames += counters.frames;
+    check(counters.bytes == captures[port]->bytes(),
+          "port counters match the bytes written");
+  }
+  check(frames == scheduler.writes(), "port frames add up to the writes");
+  check(scheduler.heap_allocations() == 0, "scheduler loop doesn't allocate");
+  check(scheduler.arena().overflow() == 0, "scheduler arena is large enough");
+}
+
+} // namespace
+
+int main() {
+  check_counting();
+  check_arena_overflow();
+  check_stream();
+  check_scheduler();
+  return excserial::test::result();
+}
@@ -0,0 +1,96 @@
+/**
+ * @file modbus_test.cpp
+ * @brief Polling simulated Modbus slaves in virtual time: responses split by
+ * a gap stay whole, exceptions and silent slaves end as they should.
+ */
+
+#include "check.h"
+
+#include "excserial/clock.h"
+#include "excserial/modbus.h"
+#include "excserial/modbus_slave_port.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+namespace {
+
+using excserial::test::check;
+using namespace std::chrono_literals;
+
+constexpr std::uint64_t requests = 200;
+
+/// 9600 baud, a character is about 1 ms and a frame ends after 1.5 of
+/// silence.
+const excserial::PortSettings line{.baud_rate = CBR_9600};
+
+excserial::PollStats poll(excserial::ModbusSlavePort &slaves,
+                          excserial::VirtualClock &clock,
+                          const excserial::ModbusPoll &config) {
+  excserial::ModbusPoller poller;
+  poller.use_clock(clock);
+  poller.add_poll(config);
+  if (!check(poller.start(slaves, line, requests), "poller starts"))
+    return {};
+  while (poller.running())
+    std::this_thread::sleep_for(1ms);
+  poller.stop();
+  check(poller.error().empty(), "poller runs without error");
+  check(poller.stray_bytes() == 0, "no response is left behind");
+  return poller.stats(0);
+}
+
+/// A pause inside a response, longer than the end of frame silence.
+void check_gap() {
+  excserial::VirtualClock clock;
+  excserial::ModbusSlavePort slaves(clock, line);
+  slaves.add_slave(1);
+  slaves.set_gap(8, 5ms);
+  const auto stats = poll(slaves, clock,
+                          {.slave = 1,
+                           .count = 8,
+                           .period = excserial::Period::from_rate(20.0)});
+  check(stats.requests == requests, "every request is sent");
+  check(stats.responses == requests,
+        "a gap inside a response doesn't split it, " +
+            std::to_string(stats.bad_frames) + " bad frames");
+}
+
+/// An exception response is complete at 5 bytes, though more were asked.
+void check_exception() {
+  excserial::VirtualClock clock;
+  excserial::ModbusSlavePort slaves(clock, line);
+  slaves.add_slave(1);
+  const auto stats = poll(slaves, clock,
+                          {.slave = 1,
+                           .address = 999,
+                           .count = 8,
+                           .period = excserial::Period::from_rate(20.0)});
+  check(stats.exceptions == requests, "every read is refused");
+  check(stats.timeouts == 0 && stats.bad_frames == 0,
+        "exception responses end at 5 bytes");
+  check(stats.missed == 0, "exception responses don't wait out the timeout");
+}
+
+/// A slave that never answers costs its response timeout.
+void check_timeout() {
+  excserial::VirtualClock clock;
+  excserial::ModbusSlavePort slaves(clock, line);
+  const auto stats = poll(slaves, clock,
+                          {.slave = 7,
+                           .count = 8,
+                           .period = excserial::Period::from_rate(10.0)});
+  check(stats.timeouts == requests, "a silent slave times out");
+  check(stats.missed == 0, "timeouts end within the response timeout");
+}
+
+} // namespace
+
+int main() {
+  check_gap();
+  check_exception();
+  check_timeout();
+  return excserial::test::result();
+}
@@ -0,0 +1,68 @@
+/**
+ * @file pacing_test.cpp
+ * @brief The pacer holds exact rates over a billion virtual frames.
+ *
+ * Rates are kept to a thousandth of a hertz as an exact fraction of a
+ * nanosecond period, so after n frames the deadline must be n / rate
+ * rounded down to whole nanoseconds, with no drift at all.
+ */
+
+#include "check.h"
+
+#include "excserial/clock.h"
+#include "excserial/pacer.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+namespace {
+
+using excserial::test::check;
+
+/// Nanoseconds of frames at millihertz, rounded down, in integers so the
+/// reference can't drift itself. millihertz * 10^12 must fit 64 bits.
+std::uint64_t exact_ns(std::uint64_t frames, std::uint64_t millihertz) {
+  constexpr std::uint64_t ns_per_ks = 1'000'000'000'000;
+  return frames / millihertz * ns_per_ks +
+         frames % millihertz * ns_per_ks / millihertz;
+}
+
+/// Paces frames in virtual time, checking the deadline every checkpoint.
+void check_rate(std::uint64_t millihertz, std::uint64_t frames) {
+  excserial::VirtualClock clock;
+  excserial::Pacer pacer{
+      excserial::Period::from_rate(static_cast<double>(millihertz) / 1e3),
+      clock};
+  const auto name = std::to_string(millihertz) + " mHz";
+  const auto checkpoint = frames / 10;
+  for (std::uint64_t frame = 1; frame <= frames; ++frame) {
+    pacer.wait();
+    if (frame % checkpoint != 0)
+      continue;
+    const auto deadline = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        pacer.deadline().time_since_epoch());
+    const auto drift = deadline.count() -
+                       static_cast<std::int64_t>(exact_ns(frame, millihertz));
+    if (!check(drift == 0, name + " drifted by " + std::to_string(drift) +
+                               " ns after " + std::to_string(frame) +
+                               " frames"))
+      return;
+  }
+  std::cout << name << ": no drift over " << frames << " frames"
+            << std::endl;
+}
+
+} // namespace
+
+int main() {
+  // 300 Hz is a third of a nanosecond off any whole period, a billion
+  // frames are 39 days of streaming
+  check_rate(300'000, 1'000'000'000);
+  check_rate(7'000, 100'000'000);
+  check_rate(1'000'000, 100'000'000);
+  check_rate(333'333, 100'000'000);
+  check_rate(9'999'999, 100'000'000);
+  return excserial::test::result();
+}
@@ -0,0 +1,88 @@
+/**
+ * @file shm_latency_test.cpp
+ * @brief Producer-to-wire latency of shared memory input.
+ *
+ * Usage: shm_latency_test [MAX_MEAN_US]
+ * A producer publishes into a shared memory block at 300 Hz while a 1 kHz
+ * stream samples it, and the time from excserial_shm_publish() to the
+ * port's write is measured for every fresh sample. Fails if a sample is
+ * lost or the mean exceeds MAX_MEAN_US (default 2000, two periods).
+ */
+
+#include "check.h"
+
+#include "excserial/args.h"
+#include "excserial/capture_port.h"
+#include "excserial/stream.h"
+#include "excserial_shm.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace {
+
+using excserial::test::check;
+using namespace std::chrono_literals;
+
+constexpr auto run_time = 2s;
+constexpr auto publish_period = std::chrono::microseconds(3333);
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  double max_mean_us = 2000.0;
+  if (argc > 1 && (!excserial::parse_number(argv[1], max_mean_us) ||
+                   max_mean_us <= 0.0)) {
+    std::cerr << "Invalid latency limit: " << argv[1] << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // The producer starts first and owns the block, as in excserial_shm.h
+  HANDLE mapping = nullptr;
+  auto *block = excserial_shm_open("latency-test", &mapping);
+  if (!check(block != nullptr, "producer creates the block"))
+    return excserial::test::result();
+
+  excserial::Stream stream;
+  excserial::CapturePort capture;
+  stream.use_port(capture);
+  if (!check(stream.start({.rate_hz = 1000.0,
+                           .shm_name = "latency-test",
+                           .pacing = excserial::PacingMode::hybrid}),
+             "stream opens the block")) {
+    std::cerr << stream.error() << std::endl;
+    excserial_shm_close(block, mapping);
+    return excserial::test::result();
+  }
+
+  // Publishes off the stream's grid, so samples wait anywhere in a period
+  std::uint64_t published = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (auto next = start; next - start < run_time; next += publish_period) {
+    std::this_thread::sleep_until(next);
+    const auto value = static_cast<std::int32_t>(++published);
+    const std::int32_t values[EXCSERIAL_SHM_CHANNELS] = {value, -value,
+                                                         value, -value};
+    excserial_shm_publish(block, values);
+  }
+  std::this_thread::sleep_for(10ms); // Let the last sample go out
+  stream.stop();
+  excserial_shm_close(block, mapping);
+
+  const auto stats = stream.stats();
+  check(stream.error().empty(), "stream runs without error");
+  std::cout << std::fixed << std::setprecision(1) << "Publish to write over "
+            << stats.latency_count << " of " << published
+            << " samples: min " << stats.latency_min_us << " us, mean "
+            << stats.latency_avg_us << " us, max " << stats.latency_max_us
+            << " us" << std::endl;
+  check(stats.latency_count == published, "every sample reaches the wire");
+  check(stats.latency_avg_us <= max_mean_us,
+        "mean latency within " + std::to_string(max_mean_us) + " us");
+  return excserial::test::result();
+}
@@ -0,0 +1,98 @@
+/**
+ * @file soak_test.cpp
+ * @brief Soak throughput counts what the port reports queued, whether its
+ * driver completes writes on the wire or keeps them queued.
+ */
+
+#include "check.h"
+
+#include "excserial/port.h"
+#include "excserial/soak.h"
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+
+namespace {
+
+using excserial::test::check;
+using namespace std::chrono_literals;
+
+/// Takes every write, reporting them sent at once or never sent.
+class QueuePort final : public excserial::Port {
+public:
+  explicit QueuePort(bool drains) : drains_(drains) {
+  }
+
+  bool write(std::span<const char> data) override {
+    std::lock_guard lock(mutex_);
+    written_ += data.size();
+    return true;
+  }
+  std::size_t queued_bytes() override {
+    std::lock_guard lock(mutex_);
+    return drains_ ? 0 : written_;
+  }
+
+  const std::string &name() const override {
+    return name_;
+  }
+  const std::string &error() const override {
+    return error_;
+  }
+
+  std::uint64_t written() {
+    std::lock_guard lock(mutex_);
+    return written_;
+  }
+
+private:
+  bool drains_;
+  std::mutex mutex_;
+  std::uint64_t written_ = 0;
+  std::string name_ = "queue";
+  std::string error_;
+};
+
+excserial::SoakStats soak(QueuePort &port) {
+  excserial::SoakSender sender;
+  // 20 ms at 1 MB/s, blocks of about 10 kB
+  check(sender.start(port, 1e6, 20ms, {1, 2, 3, 4}, true), "soak starts");
+  std::this_thread::sleep_for(100ms);
+  sender.stop();
+  check(sender.error().empty(), "soak runs without error");
+  return sender.stats();
+}
+
+/// Writes that return once on the wire leave nothing queued.
+void check_drained() {
+  QueuePort port{true};
+  const auto stats = soak(port);
+  check(stats.bytes == port.written(), "bytes count every write");
+  check(stats.bytes > 0 && stats.queued_bytes == 0,
+        "nothing is left queued when the driver says so");
+  const auto expected = static_cast<double>(stats.bytes) /
+                        std::chrono::duration<double>(stats.elapsed).count();
+  check(stats.throughput() == expected, "throughput counts every byte");
+}
+
+/// Bytes still queued have not been sent.
+void check_stuck() {
+  QueuePort port{false};
+  const auto stats = soak(port);
+  check(stats.bytes > 0 && stats.bytes <= 20'000,
+        "writes stop at the fill level");
+  check(stats.queued_bytes == stats.bytes, "every byte is still queued");
+  check(stats.throughput() == 0.0, "nothing queued counts as sent");
+}
+
+} // namespace
+
+int main() {
+  check_drained();
+  check_stuck();
+  return excserial::test::result();
+}
@@ -0,0 +1,127 @@
+/**
+ * @file timer_wheel_test.cpp
+ * @brief Timer wheel expiry order, and its cost per tick staying flat from
+ * 1 to 1000 streams.
+ *
+ * Usage: timer_wheel_test [MAX_GROWTH]
+ * Fails if serving a tick with 1000 streams costs more than MAX_GROWTH
+ * (default 3) times as much as with one stream.
+ */
+
+#include "check.h"
+
+#include "excserial/args.h"
+#include "excserial/timer_wheel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+namespace {
+
+using excserial::test::check;
+
+/// Periods from 1 to 20 ms in microsecond ticks, spread so that deadlines
+/// both collide and drift apart like a real mix of rates.
+std::uint64_t period_of(std::size_t stream) {
+  return 1000 + (stream * 7919) % 19000;
+}
+
+/// Serves ticks against a plain list of deadlines.
+void check_expiry_order() {
+  constexpr std::size_t streams = 100;
+  constexpr std::uint64_t ticks = 100'000;
+  excserial::TimerWheel wheel(streams);
+  std::vector<std::uint64_t> deadlines(streams);
+  for (std::size_t i = 0; i < streams; ++i) {
+    // Some far out, beyond the wheel's range, to go through the overflow
+    deadlines[i] = i % 10 == 0 ? (std::uint64_t{1} << 31) + i : period_of(i);
+    wheel.schedule(static_cast<std::uint32_t>(i), deadlines[i]);
+  }
+  std::pmr::vector<std::uint32_t> due;
+  due.reserve(streams);
+
+  std::uint64_t served = 0;
+  while (served < ticks) {
+    const auto earliest =
+        *std::min_element(deadlines.begin(), deadlines.end());
+    const auto next = wheel.next_expiry();
+    if (!check(next && *next == earliest, "next expiry is the earliest"))
+      return;
+    due.clear();
+    wheel.advance(earliest, due);
+    const auto expected = static_cast<std::size_t>(
+        std::count(deadlines.begin(), deadlines.end(), earliest));
+    if (!check(due.size() == expected, "every due timer expires at once"))
+      return;
+    for (const auto id : due) {
+      if (!check(deadlines[id] == earliest, "only due timers expire"))
+        return;
+      deadlines[id] = earliest + period_of(id);
+      wheel.schedule(id, deadlines[id]);
+    }
+    served += due.size();
+  }
+  check(wheel.size() == streams, "every timer stays pending");
+}
+
+/// Nanoseconds of wheel bookkeeping per served stream tick, without I/O.
+double ns_per_tick(std::size_t streams) {
+  constexpr std::uint64_t ticks = 2'000'000;
+  excserial::TimerWheel wheel(streams);
+  for (std::size_t i = 0; i < streams; ++i)
+    wheel.schedule(static_cast<std::uint32_t>(i), period_of(i));
+  std::pmr::vector<std::uint32_t> due;
+  due.reserve(streams);
+
+  std::uint64_t served = 0;
+  const auto start = std::chrono::steady_clock::now();
+  while (served < ticks) {
+    const auto next = *wheel.next_expiry();
+    due.clear();
+    wheel.advance(next, due);
+    for (const auto id : due)
+      wheel.schedule(id, next + period_of(id));
+    served += due.size();
+  }
+  const std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / static_cast<double>(served);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  double max_growth = 3.0;
+  if (argc > 1 && (!excserial::parse_number(argv[1], max_growth) ||
+                   max_growth < 1.0)) {
+    std::cerr << "Invalid growth limit: " << argv[1] << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  check_expiry_order();
+
+  // Best of a few rounds, so a preempted round doesn't fail the test
+  double single = 0.0;
+  for (const std::size_t streams : {1, 10, 100, 1000}) {
+    double best = 0.0;
+    for (int round = 0; round < 3; ++round) {
+      const auto cost = ns_per_tick(streams);
+      best = round == 0 ? cost : std::min(best, cost);
+    }
+    if (streams == 1)
+      single = best;
+    std::cout << "Schedule " << std::setw(4) << streams << " streams: "
+              << std::fixed << std::setprecision(1) << best
+              << " ns per tick" << std::endl;
+    check(best <= single * max_growth,
+          "cost per tick grows with the stream count, was " +
+              std::to_string(best / single) + " times one stream");
+  }
+  return excserial::test::result();
+}
@@ -0,0 +1,191 @@
+/**
+ * @file writer_pool_test.cpp
+ * @brief Frames handed to the writer pool reach their ports, newest last,
+ * and a stalled port holds up no other.
+ */
+
+#include "check.h"
+
+#include "excserial/port.h"
+#include "excserial/writer_pool.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using excserial::test::check;
+using namespace std::chrono_literals;
+
+/// Remembers the last frame written, and can be made to block or fail.
+class TestPort final : public excserial::Port {
+public:
+  explicit TestPort(std::string name) : name_(std::move(name)) {
+  }
+
+  bool write(std::span<const char> data) override {
+    std::unique_lock lock(mutex_);
+    ++entered_;
+    changed_.notify_all();
+    changed_.wait(lock, [this] { return !stalled_; });
+    if (failing_) {
+      error_ = "write failed";
+      return false;
+    }
+    last_.assign(data.begin(), data.end());
+    ++writes_;
+    changed_.notify_all();
+    return true;
+  }
+
+  const std::string &name() const override {
+    return name_;
+  }
+  const std::string &error() const override {
+    return error_;
+  }
+
+  void stall(bool stalled) {
+    std::lock_guard lock(mutex_);
+    stalled_ = stalled;
+    changed_.notify_all();
+  }
+  void fail() {
+    std::lock_guard lock(mutex_);
+    failing_ = true;
+  }
+
+  /// Waits until a write has started, e.g. to hold a writer thread.
+  bool wait_entered() {
+    std::unique_lock lock(mutex_);
+    return changed_.wait_for(lock, 5s, [this] { return entered_ > 0; });
+  }
+  /// Waits until frame is the last one written.
+  bool wait_last(const std::string &frame) {
+    std::unique_lock lock(mutex_);
+    return changed_.wait_for(lock, 5s, [&] { return last_ == frame; });
+  }
+
+  std::string last() {
+    std::lock_guard lock(mutex_);
+    return last_;
+  }
+  std::uint64_t writes() {
+    std::lock_guard lock(mutex_);
+    return writes_;
+  }
+
+private:
+  std::string name_;
+  std::string error_;
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  bool stalled_ = false;
+  bool failing_ = false;
+  std::uint64_t entered_ = 0;
+  std::uint64_t writes_ = 0;
+  std::string last_;
+};
+
+struct Ports {
+  std::vector<std::unique_ptr<TestPort>> owned;
+  std::vector<excserial::Port *> ports;
+
+  explicit Ports(std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+      owned.push_back(std::make_unique<TestPort>("port" + std::to_string(i)));
+      ports.push_back(owned.back().get());
+    }
+  }
+};
+
+std::string frame(std::size_t port, int sequence) {
+  return "#" + std::to_string(port) + "," + std::to_string(sequence) + ";";
+}
+
+void submit(excserial::WriterPool &pool, std::size_t port, int sequence) {
+  const auto data = frame(port, sequence);
+  pool.submit(port, {data.data(), data.size()});
+}
+
+/// Every frame is written or dropped for a newer one, the newest always
+/// written.
+void check_handoff() {
+  constexpr std::size_t port_count = 64;
+  constexpr int frames = 1000;
+  Ports ports(port_count);
+  excserial::WriterPool pool(ports.ports, 4);
+  check(pool.thread_count() == 4, "pool runs the threads asked for");
+  for (int sequence = 0; sequence < frames; ++sequence) {
+    for (std::size_t port = 0; port < port_count; ++port)
+      submit(pool, port, sequence);
+  }
+  pool.stop();
+
+  check(pool.writes() + pool.dropped() == port_count * frames,
+        "every frame is written or dropped");
+  check(!pool.failed(), "no write failed");
+  std::uint64_t writes = 0;
+  for (std::size_t port = 0; port < port_count; ++port) {
+    check(ports.owned[port]->last() == frame(port, frames - 1),
+          "newest frame of " + ports.owned[port]->name() + " is written");
+    writes += ports.owned[port]->writes();
+  }
+  check(writes == pool.writes(), "pool counts the writes of the ports");
+}
+
+/// With one thread stuck in a port's write, the others serve the rest.
+void check_stalled_port() {
+  constexpr std::size_t port_count = 8;
+  Ports ports(port_count);
+  auto &stalled = *ports.owned[0];
+  stalled.stall(true);
+  excserial::WriterPool pool(ports.ports, 2);
+
+  submit(pool, 0, 0);
+  check(stalled.wait_entered(), "stalled port is being written");
+  for (int sequence = 0; sequence < 100; ++sequence) {
+    for (std::size_t port = 0; port < port_count; ++port)
+      submit(pool, port, sequence);
+  }
+  for (std::size_t port = 1; port < port_count; ++port) {
+    check(ports.owned[port]->wait_last(frame(port, 99)),
+          "port behind a stalled one is written");
+  }
+  check(stalled.writes() == 0, "stalled port stays stalled");
+
+  stalled.stall(false);
+  check(stalled.wait_last(frame(0, 99)), "stalled port catches up");
+  pool.stop();
+  check(stalled.writes() == 2,
+        "stalled port skips to its newest frame once free");
+}
+
+/// A failing port is reported and doesn't stop the others.
+void check_failure() {
+  Ports ports(4);
+  ports.owned[2]->fail();
+  excserial::WriterPool pool(ports.ports, 2);
+  for (std::size_t port = 0; port < 4; ++port)
+    submit(pool, port, 0);
+  pool.stop();
+  check(pool.failed(), "failed write is reported");
+  check(pool.error() == "port2: write failed", "error names the port");
+  check(ports.owned[3]->last() == frame(3, 0), "other ports are written");
+}
+
+} // namespace
+
+int main() {
+  check_handoff();
+  check_stalled_port();
+  check_failure();
+  return excserial::test::result();
+}